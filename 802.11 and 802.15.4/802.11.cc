@@ -65,8 +65,12 @@
  *   left commented inline in the program
  */
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <vector>
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
@@ -74,10 +78,16 @@
 #include "ns3/aodv-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/yans-wifi-helper.h"
+#include "ns3/yans-wifi-phy.h"
+#include "ns3/wifi-net-device.h"
 #include "ns3/flow-monitor.h"
 #include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
 #include "ns3/v4ping-helper.h"
 
+#include "link-table.h"
+#include "flow-sampler.h"
+
 
 
 using namespace ns3;
@@ -94,6 +104,12 @@ public:
 private:
   Ptr<Socket> SetupPacketReceive (Ipv4Address addr, Ptr<Node> node);
   void ReceivePacket (Ptr<Socket> socket);
+  void CountPacket (Ptr<Socket> socket);
+  void PrintSinkSummary (void) const;
+  void WriteMetrics (Ptr<FlowMonitor> flowmon, Ptr<Ipv4FlowClassifier> classifier);
+  void SaveScenario (NodeContainer nodes);
+  void SetupGridChannels (NetDeviceContainer devices, Ptr<YansWifiChannel> shared);
+  Ptr<PositionAllocator> LoadScenario ();
   // void CheckThroughput ();
 
   uint32_t port;
@@ -110,22 +126,44 @@ private:
   std::string m_protocolName;
   double m_txp;
   bool m_traceMobility;
+  bool m_xml;
+  std::string m_saveScenario;
+  std::string m_loadScenario;
+  bool m_gridChannel;
+  bool m_linkTable;
+  double m_sampleWindow;
+  bool m_quiet;
+  // Received packets and bytes, indexed by node id
+  std::vector<uint64_t> m_sinkPackets;
+  std::vector<uint64_t> m_sinkBytes;
+  std::vector<uint32_t> m_sinkNodes;  //!< Node id of each sink, in setup order
   uint32_t m_protocol;
 };
 
+// Scenario snapshot file: header, then the x, y, z position of every node
+static const uint32_t SCENARIO_MAGIC = 0x43534850;   // "PHSC"
+static const uint32_t SCENARIO_VERSION = 1;
+
+struct ScenarioHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  int32_t nNodes;
+  int32_t covAreaSide;
+};
+
 void printNodePositions()
 {
   NodeContainer const & n = NodeContainer::GetGlobal ();
   for (NodeContainer::Iterator i = n.Begin (); i != n.End (); ++i)
   {
     Ptr<Node> node = *i;
-    std::string name = Names::FindName (node);
 
     Ptr<MobilityModel> mob = node->GetObject<MobilityModel> ();
     if(!mob) continue;
 
     Vector pos = mob->GetPosition ();
-    std::cout << "Node " << name << " is at (" << pos.x << ", " <<
+    std::cout << "Node node-" << node->GetId () << " is at (" << pos.x << ", " <<
     pos.y << ", " << pos.z << ")\n";
 
   }
@@ -156,13 +194,19 @@ RoutingExperiment::RoutingExperiment ()
   : port (9),
     bytesTotal (0),
     packetsReceived (0),
+    m_CSVfileName ("metrics.csv"),
     m_nNodes (60),
     m_nFlows(10),
     m_nPacketsPerSecond(10),
     m_txRange(1000),
     m_CovAreaSide(1000),
     //add coverage area default values//
-    m_traceMobility (false)
+    m_traceMobility (false),
+    m_xml (false),
+    m_gridChannel (false),
+    m_linkTable (false),
+    m_sampleWindow (0),
+    m_quiet (false)
 {
 }
 
@@ -179,6 +223,34 @@ RoutingExperiment::ReceivePacket (Ptr<Socket> socket)
     }
 }
 
+void
+RoutingExperiment::CountPacket (Ptr<Socket> socket)
+{
+  uint32_t id = socket->GetNode ()->GetId ();
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      bytesTotal += packet->GetSize ();
+      packetsReceived += 1;
+      m_sinkPackets[id] += 1;
+      m_sinkBytes[id] += packet->GetSize ();
+    }
+}
+
+void
+RoutingExperiment::PrintSinkSummary (void) const
+{
+  std::ostringstream oss;
+  for (uint32_t i = 0; i < m_sinkNodes.size (); ++i)
+    {
+      uint32_t id = m_sinkNodes[i];
+      oss << "Sink " << i << " (node " << id << "): " << m_sinkPackets[id] << " packets, "
+          << m_sinkBytes[id] << " bytes\n";
+    }
+  oss << "Total: " << packetsReceived << " packets, " << bytesTotal << " bytes";
+  NS_LOG_UNCOND (oss.str ());
+}
+
 Ptr<Socket>
 RoutingExperiment::SetupPacketReceive (Ipv4Address addr, Ptr<Node> node)
 {
@@ -186,7 +258,21 @@ RoutingExperiment::SetupPacketReceive (Ipv4Address addr, Ptr<Node> node)
   Ptr<Socket> sink = Socket::CreateSocket (node, tid);
   InetSocketAddress local = InetSocketAddress (addr, port);
   sink->Bind (local);
-  sink->SetRecvCallback (MakeCallback (&RoutingExperiment::ReceivePacket, this));
+  if (m_quiet)
+    {
+      uint32_t id = node->GetId ();
+      if (id >= m_sinkPackets.size ())
+        {
+          m_sinkPackets.resize (id + 1, 0);
+          m_sinkBytes.resize (id + 1, 0);
+        }
+      m_sinkNodes.push_back (id);
+      sink->SetRecvCallback (MakeCallback (&RoutingExperiment::CountPacket, this));
+    }
+  else
+    {
+      sink->SetRecvCallback (MakeCallback (&RoutingExperiment::ReceivePacket, this));
+    }
 
   return sink;
 }
@@ -200,15 +286,204 @@ RoutingExperiment::CommandSetup (int argc, char **argv)
   cmd.AddValue ("packetsPerSecond", "Number of packets sent out every second", m_nPacketsPerSecond);
   cmd.AddValue ("numberOfFlows", "Number of flows", m_nFlows);
   cmd.AddValue ("coverageArea", "One side of the coverage area where the nodes are scattered", m_CovAreaSide);
+  cmd.AddValue ("CSVfileName", "Throughput, delay, delivery and drop ratio of the run", m_CSVfileName);
+  cmd.AddValue ("xml", "Also write the FlowMonitor XML file", m_xml);
+  cmd.AddValue ("saveScenario", "Write the node layout of this run to a scenario file", m_saveScenario);
+  cmd.AddValue ("loadScenario", "Place the nodes as in a scenario file instead of at random", m_loadScenario);
+  cmd.AddValue ("quiet", "Only count the received packets, print a per-sink summary at the end", m_quiet);
+  cmd.AddValue ("sampleWindow", "Write per-flow statistics every sampleWindow seconds to windows.csv (0: off)", m_sampleWindow);
+  cmd.AddValue ("linkTable", "Precompute the loss between every pair of (static) nodes", m_linkTable);
+  cmd.AddValue ("gridChannel", "Deliver each transmission only to the nodes within range (static nodes)", m_gridChannel);
   cmd.Parse (argc, argv);
   return m_CSVfileName;
 }
 
+void
+RoutingExperiment::WriteMetrics (Ptr<FlowMonitor> flowmon, Ptr<Ipv4FlowClassifier> classifier)
+{
+  // Same reduction as parser_802.11.py, straight from the flow statistics
+  flowmon->CheckForLostPackets ();
+  const FlowMonitor::FlowStatsContainer &stats = flowmon->GetFlowStats ();
+
+  double bitrateSum = 0;
+  uint32_t nBitrates = 0;
+  double delaySum = 0;
+  uint32_t nDelays = 0;
+  uint64_t totalRx = 0;
+  uint64_t totalTx = 0;
+  uint64_t dropped = 0;
+  for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      if (classifier->FindFlow (i->first).destinationPort == 654)
+        {
+          continue; // AODV control traffic
+        }
+      const FlowMonitor::FlowStats &flow = i->second;
+      totalRx += flow.rxPackets;
+      totalTx += flow.txPackets;
+      for (uint32_t n : flow.packetsDropped)
+        {
+          dropped += n;
+        }
+      if (flow.rxPackets == 0)
+        {
+          ++nBitrates;
+          continue;
+        }
+      double duration = (flow.timeLastRxPacket - flow.timeFirstRxPacket).GetSeconds ();
+      if (duration == 0)
+        {
+          continue;
+        }
+      bitrateSum += 8 * flow.rxBytes / duration * 1e-3;
+      ++nBitrates;
+      delaySum += flow.delaySum.GetSeconds () / flow.rxPackets;
+      ++nDelays;
+    }
+
+  double throughput = nBitrates ? bitrateSum / nBitrates : 0;
+  double delay = nDelays ? delaySum / nDelays : 0;
+  double deliveryRatio = totalTx ? static_cast<double> (totalRx) / totalTx : 0;
+  double dropRatio = totalTx ? static_cast<double> (dropped) / totalTx : 0;
+
+  std::cout << "Throughput : " << throughput << " kbit/s" << std::endl;
+  std::cout << "Average end-to-end delay : " << delay << " s" << std::endl;
+  std::cout << "Delivery ratio : " << deliveryRatio << std::endl;
+  std::cout << "Drop ratio : " << dropRatio << std::endl;
+
+  std::ofstream out (m_CSVfileName.c_str ());
+  out << "Throughput,EndToEndDelay,DeliveryRatio,DropRatio" << std::endl;
+  out << throughput << "," << delay << "," << deliveryRatio << "," << dropRatio << std::endl;
+}
+
+void
+RoutingExperiment::SaveScenario (NodeContainer nodes)
+{
+  std::ofstream out (m_saveScenario.c_str (), std::ios::out | std::ios::binary);
+  NS_ABORT_MSG_UNLESS (out.is_open (), "Cannot open " << m_saveScenario);
+  ScenarioHeader header = {SCENARIO_MAGIC, SCENARIO_VERSION, m_nNodes, m_CovAreaSide};
+  out.write (reinterpret_cast<const char *> (&header), sizeof (header));
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+    {
+      Vector pos = (*i)->GetObject<MobilityModel> ()->GetPosition ();
+      double xyz[3] = {pos.x, pos.y, pos.z};
+      out.write (reinterpret_cast<const char *> (xyz), sizeof (xyz));
+    }
+}
+
+Ptr<PositionAllocator>
+RoutingExperiment::LoadScenario ()
+{
+  std::ifstream in (m_loadScenario.c_str (), std::ios::in | std::ios::binary);
+  NS_ABORT_MSG_UNLESS (in.is_open (), "Cannot open " << m_loadScenario);
+  ScenarioHeader header;
+  in.read (reinterpret_cast<char *> (&header), sizeof (header));
+  NS_ABORT_MSG_UNLESS (in && header.magic == SCENARIO_MAGIC && header.version == SCENARIO_VERSION,
+                       m_loadScenario << " is not a version " << SCENARIO_VERSION << " scenario");
+  NS_ABORT_MSG_UNLESS (header.nNodes == m_nNodes && header.covAreaSide == m_CovAreaSide,
+                       m_loadScenario << " has " << header.nNodes << " nodes on a "
+                       << header.covAreaSide << " m side, not " << m_nNodes << " on "
+                       << m_CovAreaSide);
+
+  std::vector<double> xyz (3 * header.nNodes);
+  in.read (reinterpret_cast<char *> (xyz.data ()), xyz.size () * sizeof (double));
+  NS_ABORT_MSG_UNLESS (in, m_loadScenario << " is truncated");
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  for (int i = 0; i < header.nNodes; ++i)
+    {
+      positions->Add (Vector (xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]));
+    }
+  return positions;
+}
+
+void
+RoutingExperiment::SetupGridChannels (NetDeviceContainer devices, Ptr<YansWifiChannel> shared)
+{
+  // YansWifiChannel schedules a receive event for every PHY it holds, and the
+  // range loss model only drops the out-of-range ones afterwards. The nodes
+  // do not move, so give every PHY a channel of its own that holds only the
+  // PHYs within range, found through a grid of range-sized cells: sending
+  // on it reaches the same receivers at O(neighbours) cost.
+  PointerValue lossValue;
+  PointerValue delayValue;
+  shared->GetAttribute ("PropagationLossModel", lossValue);
+  shared->GetAttribute ("PropagationDelayModel", delayValue);
+  Ptr<PropagationLossModel> loss = lossValue.Get<PropagationLossModel> ();
+  Ptr<PropagationDelayModel> delay = delayValue.Get<PropagationDelayModel> ();
+  Ptr<LinkTablePropagationLossModel> table = DynamicCast<LinkTablePropagationLossModel> (loss);
+  Ptr<RangePropagationLossModel> range = DynamicCast<RangePropagationLossModel> (table != 0 ? table->GetModel () : loss);
+  NS_ABORT_MSG_UNLESS (range != 0, "gridChannel needs a RangePropagationLossModel");
+  DoubleValue maxRange;
+  range->GetAttribute ("MaxRange", maxRange);
+  double cell = maxRange.Get ();
+
+  std::vector<Ptr<YansWifiPhy> > phys;
+  std::vector<Vector> positions;
+  std::map<std::pair<int64_t, int64_t>, std::vector<uint32_t> > grid;
+  for (uint32_t i = 0; i < devices.GetN (); ++i)
+    {
+      Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice> (devices.Get (i));
+      Ptr<MobilityModel> mobility = device->GetNode ()->GetObject<MobilityModel> ();
+      NS_ABORT_MSG_UNLESS (DynamicCast<ConstantPositionMobilityModel> (mobility) != 0,
+                           "gridChannel needs static nodes");
+      Vector pos = mobility->GetPosition ();
+      phys.push_back (DynamicCast<YansWifiPhy> (device->GetPhy ()));
+      positions.push_back (pos);
+      grid[std::make_pair (static_cast<int64_t> (std::floor (pos.x / cell)),
+                           static_cast<int64_t> (std::floor (pos.y / cell)))].push_back (i);
+    }
+
+  uint64_t links = 0;
+  for (uint32_t i = 0; i < phys.size (); ++i)
+    {
+      int64_t cx = static_cast<int64_t> (std::floor (positions[i].x / cell));
+      int64_t cy = static_cast<int64_t> (std::floor (positions[i].y / cell));
+      std::vector<uint32_t> neighbours;
+      for (int64_t dx = -1; dx <= 1; ++dx)
+        {
+          for (int64_t dy = -1; dy <= 1; ++dy)
+            {
+              std::map<std::pair<int64_t, int64_t>, std::vector<uint32_t> >::const_iterator it =
+                grid.find (std::make_pair (cx + dx, cy + dy));
+              if (it == grid.end ())
+                {
+                  continue;
+                }
+              for (uint32_t j : it->second)
+                {
+                  if (j != i && CalculateDistance (positions[i], positions[j]) <= cell)
+                    {
+                      neighbours.push_back (j);
+                    }
+                }
+            }
+        }
+      // Same order as on the shared channel, so simultaneous receptions are
+      // scheduled in the same order
+      std::sort (neighbours.begin (), neighbours.end ());
+
+      Ptr<YansWifiChannel> own = CreateObject<YansWifiChannel> ();
+      own->SetPropagationLossModel (loss);
+      own->SetPropagationDelayModel (delay);
+      phys[i]->SetChannel (own);
+      for (uint32_t j : neighbours)
+        {
+          own->Add (phys[j]);
+        }
+      links += neighbours.size ();
+    }
+  std::cout << "gridChannel: " << cell << " m range, "
+            << static_cast<double> (links) / phys.size () << " neighbours per node" << std::endl;
+}
+
 void
 RoutingExperiment::Run (double txp, double time)
 {
   //setup
-  Packet::EnablePrinting ();
+  if (!m_quiet)
+    {
+      Packet::EnablePrinting ();
+    }
   m_txp = txp;
 
   int packetSize = 64;
@@ -239,33 +514,39 @@ RoutingExperiment::Run (double txp, double time)
 //CreateNodes
   NodeContainer adhocNodes;
   adhocNodes.Create (m_nNodes);
-  //Name nodes
-  for (int i = 0; i < m_nNodes; ++i)
-    {
-      std::ostringstream os;
-      os << "node-" << i;
-      Names::Add (os.str (), adhocNodes.Get (i));
-   }
 
   MobilityHelper mobilityAdhoc;
-  
-  // double maxCoverageLength = m_CovAreaSide;
-  std::ostringstream cvg;
-  cvg << "ns3::UniformRandomVariable[Min=0.0|Max="<<m_CovAreaSide<<"]";
-  std::string rect (cvg.str());
-  std::cout<<"rectange "<<rect<<" by "<<rect<<std::endl;
-  
-  ObjectFactory pos;
-  pos.SetTypeId ("ns3::RandomRectanglePositionAllocator");
-  pos.Set ("X", StringValue (rect));
-  pos.Set ("Y", StringValue (rect));
 
-  Ptr<PositionAllocator> taPositionAlloc = pos.Create ()->GetObject<PositionAllocator> ();
+  Ptr<PositionAllocator> taPositionAlloc;
+  if (!m_loadScenario.empty ())
+    {
+      taPositionAlloc = LoadScenario ();
+    }
+  else
+    {
+      // double maxCoverageLength = m_CovAreaSide;
+      std::ostringstream cvg;
+      cvg << "ns3::UniformRandomVariable[Min=0.0|Max="<<m_CovAreaSide<<"]";
+      std::string rect (cvg.str());
+      std::cout<<"rectange "<<rect<<" by "<<rect<<std::endl;
+
+      ObjectFactory pos;
+      pos.SetTypeId ("ns3::RandomRectanglePositionAllocator");
+      pos.Set ("X", StringValue (rect));
+      pos.Set ("Y", StringValue (rect));
+
+      taPositionAlloc = pos.Create ()->GetObject<PositionAllocator> ();
+    }
 
   mobilityAdhoc.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
   mobilityAdhoc.SetPositionAllocator (taPositionAlloc);
   mobilityAdhoc.Install (adhocNodes);
 
+  if (!m_saveScenario.empty ())
+    {
+      SaveScenario (adhocNodes);
+    }
+
   //printNodePositions();
 
 
@@ -278,7 +559,8 @@ RoutingExperiment::Run (double txp, double time)
   YansWifiChannelHelper wifiChannel;
   wifiChannel.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
   wifiChannel.AddPropagationLoss ("ns3::RangePropagationLossModel"); //previously used friis //range prop not working though
-  wifiPhy.SetChannel (wifiChannel.Create ());
+  Ptr<YansWifiChannel> channel = wifiChannel.Create ();
+  wifiPhy.SetChannel (channel);
 
   Config::SetDefault ("ns3::RangePropagationLossModel::MaxRange", DoubleValue (m_txRange));
 
@@ -294,6 +576,18 @@ RoutingExperiment::Run (double txp, double time)
 
   wifiMac.SetType ("ns3::AdhocWifiMac");
   NetDeviceContainer adhocDevices = wifi.Install (wifiPhy, wifiMac, adhocNodes);
+  if (m_linkTable)
+    {
+      PointerValue loss;
+      channel->GetAttribute ("PropagationLossModel", loss);
+      Ptr<LinkTablePropagationLossModel> table = CreateObject<LinkTablePropagationLossModel> ();
+      table->Build (adhocNodes, loss.Get<PropagationLossModel> ());
+      channel->SetPropagationLossModel (table);
+    }
+  if (m_gridChannel)
+    {
+      SetupGridChannels (adhocDevices, channel);
+    }
 
 
   //InstallInternetStack
@@ -335,6 +629,13 @@ RoutingExperiment::Run (double txp, double time)
   Ptr<FlowMonitor> flowmon;
   FlowMonitorHelper flowmonHelper;
   flowmon = flowmonHelper.InstallAll ();
+  FlowWindowSampler *sampler = 0;
+  if (m_sampleWindow > 0)
+    {
+      uint32_t windows = std::ceil (TotalTime / m_sampleWindow);
+      sampler = new FlowWindowSampler (flowmon, Seconds (m_sampleWindow), windows + 1);
+      sampler->Start (Seconds (m_sampleWindow));
+    }
 
 
   NS_LOG_INFO ("Run Simulation.");
@@ -344,7 +645,20 @@ RoutingExperiment::Run (double txp, double time)
   Simulator::Stop (Seconds (TotalTime));
   Simulator::Run ();
 
-  flowmon->SerializeToXmlFile ((tr_name + ".xml").c_str(), false, false);
+  if (m_quiet)
+    {
+      PrintSinkSummary ();
+    }
+  if (sampler != 0)
+    {
+      sampler->Write ("windows.csv");
+      delete sampler;
+    }
+  WriteMetrics (flowmon, DynamicCast<Ipv4FlowClassifier> (flowmonHelper.GetClassifier ()));
+  if (m_xml)
+    {
+      flowmon->SerializeToXmlFile ((tr_name + ".xml").c_str(), false, false);
+    }
 
   Simulator::Destroy ();
 }
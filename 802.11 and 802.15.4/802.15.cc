@@ -32,6 +32,7 @@
 // This example is based on the "ping6.cc" example.
 
 #include <fstream>
+#include <vector>
 #include "ns3/core-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/sixlowpan-module.h"
@@ -47,6 +48,13 @@
 #include "ns3/flow-monitor-helper.h"
 #include "ns3/internet-stack-helper.h"
 #include <ns3/ripng-helper.h>
+#include "ns3/single-model-spectrum-channel.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/csma-module.h"
+#include "ns3/ipv6-static-routing-helper.h"
+
+#include "link-table.h"
+#include "flow-sampler.h"
 
 using namespace ns3;
 
@@ -62,11 +70,18 @@ public:
 private:
   Ptr<Socket> SetupPacketReceive (Ipv6Address addr, Ptr<Node> node);
   void ReceivePacket (Ptr<Socket> socket);
+  void CountPacket (Ptr<Socket> socket);
+  void PrintSinkSummary (void) const;
+  void WriteMetrics (Ptr<FlowMonitor> flowmon);
+  Ptr<SpectrumChannel> CreateLinkTableChannel (NodeContainer nodes);
+  void InstallSinglePan (NodeContainer adhocNodes, std::vector<Ipv6Address> &nodeAddress);
+  void InstallPans (NodeContainer nodes, std::vector<Ipv6Address> &nodeAddress);
 
   uint32_t port;
   uint32_t bytesTotal;
   uint32_t packetsReceived;
 
+  std::string m_CSVfileName;
   int m_nFlows;
   int m_nodes;
   int m_nPacketsPerSecond;
@@ -75,6 +90,15 @@ private:
   std::string m_protocolName;
   double m_txp;
   bool m_traceMobility;
+  bool m_xml;
+  bool m_linkTable;
+  int m_panGrid;
+  double m_sampleWindow;
+  bool m_quiet;
+  // Received packets and bytes, indexed by node id
+  std::vector<uint64_t> m_sinkPackets;
+  std::vector<uint64_t> m_sinkBytes;
+  std::vector<uint32_t> m_sinkNodes;  //!< Node id of each sink, in setup order
   // uint32_t m_protocol;
 };
 
@@ -82,12 +106,18 @@ RoutingExperiment::RoutingExperiment ()
   : port (9),
     bytesTotal (0),
     packetsReceived (0),
+    m_CSVfileName ("metrics.csv"),
     m_nFlows(5),
     m_nodes(60),
     m_nPacketsPerSecond(1),
     m_txRange(1000),
     m_CoverageArea(300),
-    m_traceMobility (false)
+    m_traceMobility (false),
+    m_xml (false),
+    m_linkTable (false),
+    m_panGrid (1),
+    m_sampleWindow (0),
+    m_quiet (false)
 {
 }
 
@@ -123,6 +153,34 @@ RoutingExperiment::ReceivePacket (Ptr<Socket> socket)
     }
 }
 
+void
+RoutingExperiment::CountPacket (Ptr<Socket> socket)
+{
+  uint32_t id = socket->GetNode ()->GetId ();
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()))
+    {
+      bytesTotal += packet->GetSize ();
+      packetsReceived += 1;
+      m_sinkPackets[id] += 1;
+      m_sinkBytes[id] += packet->GetSize ();
+    }
+}
+
+void
+RoutingExperiment::PrintSinkSummary (void) const
+{
+  std::ostringstream oss;
+  for (uint32_t i = 0; i < m_sinkNodes.size (); ++i)
+    {
+      uint32_t id = m_sinkNodes[i];
+      oss << "Sink " << i << " (node " << id << "): " << m_sinkPackets[id] << " packets, "
+          << m_sinkBytes[id] << " bytes\n";
+    }
+  oss << "Total: " << packetsReceived << " packets, " << bytesTotal << " bytes";
+  NS_LOG_UNCOND (oss.str ());
+}
+
 
 Ptr<Socket>
 RoutingExperiment::SetupPacketReceive (Ipv6Address addr, Ptr<Node> node)
@@ -131,7 +189,21 @@ RoutingExperiment::SetupPacketReceive (Ipv6Address addr, Ptr<Node> node)
   Ptr<Socket> sink = Socket::CreateSocket (node, tid);
   Inet6SocketAddress local = Inet6SocketAddress (addr, port);
   sink->Bind (local);
-  sink->SetRecvCallback (MakeCallback (&RoutingExperiment::ReceivePacket, this));
+  if (m_quiet)
+    {
+      uint32_t id = node->GetId ();
+      if (id >= m_sinkPackets.size ())
+        {
+          m_sinkPackets.resize (id + 1, 0);
+          m_sinkBytes.resize (id + 1, 0);
+        }
+      m_sinkNodes.push_back (id);
+      sink->SetRecvCallback (MakeCallback (&RoutingExperiment::CountPacket, this));
+    }
+  else
+    {
+      sink->SetRecvCallback (MakeCallback (&RoutingExperiment::ReceivePacket, this));
+    }
 
   return sink;
 
@@ -146,10 +218,213 @@ RoutingExperiment::CommandSetup (int argc, char **argv)
   cmd.AddValue ("nodes", "Number of Nodes", m_nodes);
   cmd.AddValue ("PacketsPerSecond", "Number of packets sent out every second", m_nPacketsPerSecond);
   cmd.AddValue ("coverageArea", "One side of the coverage area where the nodes are scattered", m_CoverageArea);
+  cmd.AddValue ("CSVfileName", "Throughput, delay, delivery and drop ratio of the run", m_CSVfileName);
+  cmd.AddValue ("xml", "Also write the FlowMonitor XML file", m_xml);
+  cmd.AddValue ("panGrid", "Split the area into panGrid x panGrid PANs joined by a backbone (1: a single PAN)", m_panGrid);
+  cmd.AddValue ("quiet", "Only count the received packets, print a per-sink summary at the end", m_quiet);
+  cmd.AddValue ("sampleWindow", "Write per-flow statistics every sampleWindow seconds to windows.csv (0: off)", m_sampleWindow);
+  cmd.AddValue ("linkTable", "Precompute the loss between every pair of (static) nodes", m_linkTable);
   cmd.Parse (argc, argv);
 
 }
 
+void
+RoutingExperiment::WriteMetrics (Ptr<FlowMonitor> flowmon)
+{
+  // Same reduction as parser_802.15.4.py, straight from the flow statistics
+  flowmon->CheckForLostPackets ();
+  const FlowMonitor::FlowStatsContainer &stats = flowmon->GetFlowStats ();
+
+  double bitrateSum = 0;
+  uint32_t nBitrates = 0;
+  double delaySum = 0;
+  uint32_t nDelays = 0;
+  uint64_t totalRx = 0;
+  uint64_t totalTx = 0;
+  uint64_t lost = 0;
+  for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      const FlowMonitor::FlowStats &flow = i->second;
+      lost += flow.lostPackets;
+      totalRx += flow.rxPackets;
+      totalTx += flow.txPackets;
+      if (flow.rxPackets == 0)
+        {
+          ++nBitrates;
+          continue;
+        }
+      double duration = (flow.timeLastRxPacket - flow.timeFirstRxPacket).GetSeconds ();
+      if (duration == 0)
+        {
+          continue;
+        }
+      bitrateSum += 8 * flow.rxBytes / duration * 1e-3;
+      ++nBitrates;
+      delaySum += flow.delaySum.GetSeconds () / flow.rxPackets;
+      ++nDelays;
+    }
+
+  double throughput = nBitrates ? bitrateSum / nBitrates : 0;
+  double delay = nDelays ? delaySum / nDelays : 0;
+  double deliveryRatio = totalTx ? static_cast<double> (totalRx) / totalTx : 0;
+  double dropRatio = totalTx ? static_cast<double> (lost) / totalTx : 0;
+
+  std::cout << "Throughput : " << throughput << " kbit/s" << std::endl;
+  std::cout << "Average end-to-end delay : " << delay << " s" << std::endl;
+  std::cout << "Delivery ratio : " << deliveryRatio << std::endl;
+  std::cout << "Drop ratio : " << dropRatio << std::endl;
+
+  std::ofstream out (m_CSVfileName.c_str ());
+  out << "Throughput,EndToEndDelay,DeliveryRatio,DropRatio" << std::endl;
+  out << throughput << "," << delay << "," << deliveryRatio << "," << dropRatio << std::endl;
+}
+
+Ptr<SpectrumChannel>
+RoutingExperiment::CreateLinkTableChannel (NodeContainer nodes)
+{
+  // Same channel as the one LrWpanHelper builds, with the log distance
+  // loss tabulated
+  Ptr<SingleModelSpectrumChannel> channel = CreateObject<SingleModelSpectrumChannel> ();
+  Ptr<LinkTablePropagationLossModel> table = CreateObject<LinkTablePropagationLossModel> ();
+  table->Build (nodes, CreateObject<LogDistancePropagationLossModel> ());
+  channel->AddPropagationLossModel (table);
+  channel->SetPropagationDelayModel (CreateObject<ConstantSpeedPropagationDelayModel> ());
+  return channel;
+}
+
+void
+RoutingExperiment::InstallSinglePan (NodeContainer adhocNodes, std::vector<Ipv6Address> &nodeAddress)
+{
+  //-----------------for 802.15---------------//
+  NS_LOG_INFO ("Create channels.");
+  LrWpanHelper lrWpanHelper;
+  if (m_linkTable)
+    {
+      lrWpanHelper.SetChannel (CreateLinkTableChannel (adhocNodes));
+    }
+  
+  NetDeviceContainer devContainer = lrWpanHelper.Install(adhocNodes);
+  lrWpanHelper.AssociateToPan (devContainer, 10);
+  std::cout << "Created " << devContainer.GetN() << " devices" << std::endl;
+  std::cout << "There are " << adhocNodes.GetN() << " nodes" << std::endl;
+  //--------------for 802.15---------------//
+
+  //set routing 
+  RipNgHelper rip;
+  Ipv6ListRoutingHelper list;
+  list.Add(rip,100);
+
+  /* Install IPv4/IPv6 stack */
+  NS_LOG_INFO ("Install Internet stack.");
+  InternetStackHelper internetv6;
+  internetv6.SetIpv4StackInstall (false);
+  //internetv6.SetRoutingHelper(list);
+
+  internetv6.Install (adhocNodes);
+  // Install 6LowPan layer
+  NS_LOG_INFO ("Install 6LoWPAN.");
+  SixLowPanHelper sixlowpan;
+  NetDeviceContainer six1 = sixlowpan.Install (devContainer);
+  
+  
+  InternetStackHelper internet;
+
+
+  //NETWORK LAYER
+  NS_LOG_INFO ("Assign addresses.");
+  Ipv6AddressHelper ipv6;
+  ipv6.SetBase (Ipv6Address ("2001:1::"), Ipv6Prefix (64));
+  Ipv6InterfaceContainer adhocInterfaces = ipv6.Assign (six1);
+  for (uint32_t i = 0; i < adhocInterfaces.GetN (); i++)
+    {
+      nodeAddress[i] = adhocInterfaces.GetAddress (i,1);
+    }
+}
+
+void
+RoutingExperiment::InstallPans (NodeContainer nodes, std::vector<Ipv6Address> &nodeAddress)
+{
+  // Split the coverage square into panGrid x panGrid cells, one PAN per
+  // non-empty cell. Every PAN has its own channel, so a frame only creates
+  // events for the nodes of its PAN. The first node of a PAN is its
+  // coordinator: the other nodes use it as default router, and the
+  // coordinators share a CSMA backbone with a static route to every other
+  // PAN.
+  double cell = static_cast<double> (m_CoverageArea) / m_panGrid;
+  std::vector<NodeContainer> cells (m_panGrid * m_panGrid);
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Vector pos = nodes.Get (i)->GetObject<MobilityModel> ()->GetPosition ();
+      int cx = std::min (static_cast<int> (pos.x / cell), m_panGrid - 1);
+      int cy = std::min (static_cast<int> (pos.y / cell), m_panGrid - 1);
+      cells[cy * m_panGrid + cx].Add (nodes.Get (i));
+    }
+
+  InternetStackHelper internetv6;
+  internetv6.SetIpv4StackInstall (false);
+  internetv6.Install (nodes);
+
+  Ipv6AddressHelper ipv6;
+  ipv6.SetBase (Ipv6Address ("2001:1::"), Ipv6Prefix (64));
+  Ipv6StaticRoutingHelper routingHelper;
+  NodeContainer coordinators;
+  std::vector<Ipv6Address> panPrefix;
+  uint16_t panId = 10;
+  for (uint32_t c = 0; c < cells.size (); c++)
+    {
+      NodeContainer pan = cells[c];
+      if (pan.GetN () == 0)
+        {
+          continue;
+        }
+
+      LrWpanHelper lrWpanHelper;  // Creates a channel of its own
+      if (m_linkTable)
+        {
+          lrWpanHelper.SetChannel (CreateLinkTableChannel (pan));
+        }
+      NetDeviceContainer devContainer = lrWpanHelper.Install (pan);
+      lrWpanHelper.AssociateToPan (devContainer, panId++);
+      SixLowPanHelper sixlowpan;
+      NetDeviceContainer six = sixlowpan.Install (devContainer);
+      Ipv6InterfaceContainer interfaces = ipv6.Assign (six);
+      ipv6.NewNetwork ();
+
+      interfaces.SetForwarding (0, true);
+      for (uint32_t i = 0; i < pan.GetN (); i++)
+        {
+          nodeAddress[pan.Get (i)->GetId ()] = interfaces.GetAddress (i, 1);
+          if (i > 0)
+            {
+              Ptr<Ipv6StaticRouting> routing = routingHelper.GetStaticRouting (pan.Get (i)->GetObject<Ipv6> ());
+              routing->SetDefaultRoute (interfaces.GetAddress (0, 0), interfaces.GetInterfaceIndex (i));
+            }
+        }
+      coordinators.Add (pan.Get (0));
+      panPrefix.push_back (interfaces.GetAddress (0, 1).CombinePrefix (Ipv6Prefix (64)));
+    }
+
+  CsmaHelper csma;
+  NetDeviceContainer backboneDevices = csma.Install (coordinators);
+  ipv6.SetBase (Ipv6Address ("2001:ffff::"), Ipv6Prefix (64));
+  Ipv6InterfaceContainer backbone = ipv6.Assign (backboneDevices);
+  for (uint32_t a = 0; a < coordinators.GetN (); a++)
+    {
+      backbone.SetForwarding (a, true);
+      Ptr<Ipv6StaticRouting> routing = routingHelper.GetStaticRouting (coordinators.Get (a)->GetObject<Ipv6> ());
+      for (uint32_t b = 0; b < coordinators.GetN (); b++)
+        {
+          if (b != a)
+            {
+              routing->AddNetworkRouteTo (panPrefix[b], Ipv6Prefix (64),
+                                          backbone.GetAddress (b, 1), backbone.GetInterfaceIndex (a));
+            }
+        }
+    }
+  std::cout << "Created " << coordinators.GetN () << " PANs of about "
+            << cell << " m x " << cell << " m" << std::endl;
+}
+
 
 int main (int argc, char **argv)
 {
@@ -166,7 +441,10 @@ int main (int argc, char **argv)
 void
 RoutingExperiment::Run (int nSinks, double txp)
 {
-  Packet::EnablePrinting ();
+  if (!m_quiet)
+    {
+      Packet::EnablePrinting ();
+    }
   m_txp = txp;
 
   double TotalTime = 100.0;
@@ -220,43 +498,16 @@ RoutingExperiment::Run (int nSinks, double txp)
   //--------------end of mobility-----------------//
   Config::SetDefault ("ns3::RangePropagationLossModel::MaxRange", DoubleValue (m_txRange));
 
-  //-----------------for 802.15---------------//
-  NS_LOG_INFO ("Create channels.");
-  LrWpanHelper lrWpanHelper;
-  
-  NetDeviceContainer devContainer = lrWpanHelper.Install(adhocNodes);
-  lrWpanHelper.AssociateToPan (devContainer, 10);
-  std::cout << "Created " << devContainer.GetN() << " devices" << std::endl;
-  std::cout << "There are " << adhocNodes.GetN() << " nodes" << std::endl;
-  //--------------for 802.15---------------//
-
-  //set routing 
-  RipNgHelper rip;
-  Ipv6ListRoutingHelper list;
-  list.Add(rip,100);
-
-  /* Install IPv4/IPv6 stack */
-  NS_LOG_INFO ("Install Internet stack.");
-  InternetStackHelper internetv6;
-  internetv6.SetIpv4StackInstall (false);
-  //internetv6.SetRoutingHelper(list);
-
-  internetv6.Install (adhocNodes);
-  // Install 6LowPan layer
-  NS_LOG_INFO ("Install 6LoWPAN.");
-  SixLowPanHelper sixlowpan;
-  NetDeviceContainer six1 = sixlowpan.Install (devContainer);
-  
-  
-  InternetStackHelper internet;
-
+  std::vector<Ipv6Address> nodeAddress (m_nodes);
+  if (m_panGrid > 1)
+    {
+      InstallPans (adhocNodes, nodeAddress);
+    }
+  else
+    {
+      InstallSinglePan (adhocNodes, nodeAddress);
+    }
 
-  //NETWORK LAYER
-  NS_LOG_INFO ("Assign addresses.");
-  Ipv6AddressHelper ipv6;
-  ipv6.SetBase (Ipv6Address ("2001:1::"), Ipv6Prefix (64));
-  Ipv6InterfaceContainer adhocInterfaces = ipv6.Assign (six1);
-  
   //APPLICATION LAYER
   OnOffHelper onoff1 ("ns3::UdpSocketFactory",Address ());
   onoff1.SetAttribute ("OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=1.0]"));
@@ -267,8 +518,8 @@ RoutingExperiment::Run (int nSinks, double txp)
   for (int i = 0; i < m_nFlows; i++)
     {
       //std::cout << "i=>" << i<< std::endl;
-      Ptr<Socket> sink = SetupPacketReceive (adhocInterfaces.GetAddress (i,1), adhocNodes.Get (i));
-      AddressValue remoteAddress (Inet6SocketAddress (adhocInterfaces.GetAddress (i,1), port));
+      Ptr<Socket> sink = SetupPacketReceive (nodeAddress[i], adhocNodes.Get (i));
+      AddressValue remoteAddress (Inet6SocketAddress (nodeAddress[i], port));
       onoff1.SetAttribute ("Remote", remoteAddress);
 
       Ptr<UniformRandomVariable> var = CreateObject<UniformRandomVariable> ();
@@ -289,6 +540,13 @@ RoutingExperiment::Run (int nSinks, double txp)
   Ptr<FlowMonitor> flowmon;
   FlowMonitorHelper flowmonHelper;
   flowmon = flowmonHelper.InstallAll ();
+  FlowWindowSampler *sampler = 0;
+  if (m_sampleWindow > 0)
+    {
+      uint32_t windows = std::ceil (TotalTime / m_sampleWindow);
+      sampler = new FlowWindowSampler (flowmon, Seconds (m_sampleWindow), windows + 1);
+      sampler->Start (Seconds (m_sampleWindow));
+    }
 
 
   NS_LOG_INFO ("Run Simulation.");
@@ -297,7 +555,20 @@ RoutingExperiment::Run (int nSinks, double txp)
   Simulator::Stop (Seconds (TotalTime));
   Simulator::Run ();
 
-  flowmon->SerializeToXmlFile ((tr_name  + ".xml").c_str(), false, false);
+  if (m_quiet)
+    {
+      PrintSinkSummary ();
+    }
+  if (sampler != 0)
+    {
+      sampler->Write ("windows.csv");
+      delete sampler;
+    }
+  WriteMetrics (flowmon);
+  if (m_xml)
+    {
+      flowmon->SerializeToXmlFile ((tr_name  + ".xml").c_str(), false, false);
+    }
 
   Simulator::Destroy ();
 }
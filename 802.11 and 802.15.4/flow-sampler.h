@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Time-windowed per-flow statistics, shared by 802.11.cc, 802.15.cc and
+// simulate.cc (copy it into scratch/ next to them).
+//
+// FlowMonitor only gives totals once the run is over. FlowWindowSampler
+// reads the FlowMonitor counters at the end of every window and keeps the
+// per-window differences in a ring buffer per flow, allocated when the flow
+// is first seen. Nothing is written until Write () at the end of the run.
+//
+// The sampler only reads the counters. It does not force
+// FlowMonitor::CheckForLostPackets (), which walks every tracked packet and
+// would declare slow packets lost earlier than without sampling, changing
+// the totals of the run. The lost packets of a window are those found by
+// the periodic check of the FlowMonitor itself.
+
+#ifndef FLOW_SAMPLER_H
+#define FLOW_SAMPLER_H
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+/**
+ * \brief Periodic per-flow sampler of FlowMonitor statistics
+ */
+class FlowWindowSampler
+{
+public:
+  /**
+   * \brief Constructor
+   * \param monitor the flow monitor to sample
+   * \param window the window length
+   * \param capacity number of windows kept per flow, the oldest are
+   *        overwritten beyond that
+   */
+  FlowWindowSampler (Ptr<FlowMonitor> monitor, Time window, uint32_t capacity)
+    : m_monitor (monitor),
+      m_window (window),
+      m_capacity (capacity),
+      m_index (0)
+  {
+    NS_ABORT_MSG_UNLESS (window.IsStrictlyPositive () && capacity > 0, "Bad sampling window");
+  }
+
+  /**
+   * \brief Schedule the first sample
+   * \param start end of the first window
+   */
+  void Start (Time start)
+  {
+    m_event = Simulator::Schedule (start, &FlowWindowSampler::Sample, this);
+  }
+
+  /**
+   * \brief Write the windows of every flow as CSV in a single write
+   *
+   * Columns: window end (s), flow id, received bytes, received packets,
+   * transmitted packets, lost packets, throughput (kbit/s) and mean delay
+   * (s) over the window.
+   *
+   * \param fileName the CSV file
+   */
+  void Write (const std::string &fileName) const
+  {
+    std::ostringstream oss;
+    oss << "Time,FlowId,RxBytes,RxPackets,TxPackets,LostPackets,Throughput,Delay\n";
+    for (std::map<FlowId, FlowRing>::const_iterator i = m_flows.begin (); i != m_flows.end (); ++i)
+      {
+        const FlowRing &ring = i->second;
+        uint64_t first = ring.count > m_capacity ? ring.count - m_capacity : 0;
+        for (uint64_t k = first; k < ring.count; ++k)
+          {
+            const Window &w = ring.windows[k % m_capacity];
+            double end = m_offset.GetSeconds () + m_window.GetSeconds () * (w.index + 1);
+            oss << end << "," << i->first << "," << w.rxBytes << "," << w.rxPackets << ","
+                << w.txPackets << "," << w.lostPackets << ","
+                << w.rxBytes * 8.0 / m_window.GetSeconds () * 1e-3 << ","
+                << (w.rxPackets ? w.delayNs * 1e-9 / w.rxPackets : 0) << "\n";
+          }
+      }
+    std::ofstream out (fileName.c_str ());
+    NS_ABORT_MSG_UNLESS (out.is_open (), "Cannot open " << fileName);
+    const std::string s = oss.str ();
+    out.write (s.data (), s.size ());
+  }
+
+private:
+  /// Counters of one flow over one window
+  struct Window
+  {
+    uint32_t index;        //!< Window number
+    uint64_t rxBytes;      //!< Received bytes
+    uint32_t rxPackets;    //!< Received packets
+    uint32_t txPackets;    //!< Transmitted packets
+    uint32_t lostPackets;  //!< Packets declared lost by the FlowMonitor
+    int64_t  delayNs;      //!< Sum of the delays of the received packets
+  };
+
+  /// Windows of one flow and its counters at the last sample
+  struct FlowRing
+  {
+    std::vector<Window> windows;  //!< Ring of windows
+    uint64_t count {0};           //!< Windows recorded so far
+    uint64_t rxBytes {0};         //!< FlowStats::rxBytes at the last sample
+    uint32_t rxPackets {0};       //!< FlowStats::rxPackets at the last sample
+    uint32_t txPackets {0};       //!< FlowStats::txPackets at the last sample
+    uint32_t lostPackets {0};     //!< FlowStats::lostPackets at the last sample
+    int64_t  delayNs {0};         //!< FlowStats::delaySum at the last sample
+  };
+
+  void Sample (void)
+  {
+    if (m_index == 0)
+      {
+        m_offset = Simulator::Now () - m_window;
+      }
+    const FlowMonitor::FlowStatsContainer &stats = m_monitor->GetFlowStats ();
+    for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+      {
+        const FlowMonitor::FlowStats &s = i->second;
+        FlowRing &ring = m_flows[i->first];
+        if (ring.windows.empty ())
+          {
+            ring.windows.resize (m_capacity);
+          }
+        Window &w = ring.windows[ring.count % m_capacity];
+        w.index = m_index;
+        w.rxBytes = s.rxBytes - ring.rxBytes;
+        w.rxPackets = s.rxPackets - ring.rxPackets;
+        w.txPackets = s.txPackets - ring.txPackets;
+        w.lostPackets = s.lostPackets - ring.lostPackets;
+        w.delayNs = s.delaySum.GetNanoSeconds () - ring.delayNs;
+        ++ring.count;
+        ring.rxBytes = s.rxBytes;
+        ring.rxPackets = s.rxPackets;
+        ring.txPackets = s.txPackets;
+        ring.lostPackets = s.lostPackets;
+        ring.delayNs = s.delaySum.GetNanoSeconds ();
+      }
+    ++m_index;
+    m_event = Simulator::Schedule (m_window, &FlowWindowSampler::Sample, this);
+  }
+
+  Ptr<FlowMonitor> m_monitor;           //!< Sampled flow monitor
+  Time m_window;                        //!< Window length
+  Time m_offset;                        //!< Start of the first window
+  uint32_t m_capacity;                  //!< Windows kept per flow
+  uint32_t m_index;                     //!< Number of the current window
+  EventId m_event;                      //!< Next sample
+  std::map<FlowId, FlowRing> m_flows;   //!< Windows of each flow
+};
+
+} // namespace ns3
+
+#endif /* FLOW_SAMPLER_H */
@@ -0,0 +1,153 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Precomputed link table for static topologies, shared by 802.11.cc and
+// 802.15.cc (copy it into scratch/ next to them).
+//
+// With ConstantPositionMobilityModel nodes the loss between two nodes never
+// changes, yet the channel asks the loss model again for every frame and
+// every receiver. LinkTablePropagationLossModel evaluates the wrapped model
+// once per pair of nodes, after the mobility models are installed, and then
+// answers with a table lookup.
+
+#ifndef LINK_TABLE_H
+#define LINK_TABLE_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/propagation-loss-model.h"
+
+namespace ns3 {
+
+/**
+ * \brief Table of the loss between every pair of static nodes
+ *
+ * The gain of every pair is kept in a row-major n * n array, one row per
+ * sender, and the received power is the transmit power plus the gain.
+ *
+ * The wrapped model must be deterministic and its loss independent of the
+ * transmit power, like FriisPropagationLossModel or
+ * LogDistancePropagationLossModel. RangePropagationLossModel is only
+ * tabulated approximately: out of range it returns -1000 dBm whatever the
+ * transmit power, where the table returns the transmit power - 1000 dBm.
+ * Both are far below any reception threshold. Pairs involving a mobility
+ * model that is not in the table are passed to the wrapped model.
+ */
+class LinkTablePropagationLossModel : public PropagationLossModel
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::LinkTablePropagationLossModel")
+      .SetParent<PropagationLossModel> ()
+      .SetGroupName ("Propagation")
+      .AddConstructor<LinkTablePropagationLossModel> ()
+    ;
+    return tid;
+  }
+
+  LinkTablePropagationLossModel ()
+    : m_n (0)
+  {
+  }
+
+  /**
+   * \brief Tabulate the loss between every pair of nodes
+   * \param nodes the nodes, with their mobility model installed
+   * \param model the loss model to tabulate
+   */
+  void Build (NodeContainer nodes, Ptr<PropagationLossModel> model)
+  {
+    m_model = model;
+    m_n = nodes.GetN ();
+    m_index.clear ();
+    std::vector<Ptr<MobilityModel> > mobility (m_n);
+    for (uint32_t i = 0; i < m_n; ++i)
+      {
+        mobility[i] = nodes.Get (i)->GetObject<MobilityModel> ();
+        NS_ABORT_MSG_UNLESS (mobility[i] != 0, "Node " << i << " has no mobility model");
+        m_index[PeekPointer (mobility[i])] = i;
+      }
+
+    // Received power of a 0 dBm transmission, i.e. the gain in dB
+    m_gainDb.resize (static_cast<size_t> (m_n) * m_n);
+    for (uint32_t i = 0; i < m_n; ++i)
+      {
+        for (uint32_t j = 0; j < m_n; ++j)
+          {
+            m_gainDb[static_cast<size_t> (i) * m_n + j] =
+              i == j ? 0 : m_model->CalcRxPower (0, mobility[i], mobility[j]);
+          }
+      }
+  }
+
+  /**
+   * \brief Get the tabulated model
+   * \return the wrapped loss model
+   */
+  Ptr<PropagationLossModel> GetModel (void) const
+  {
+    return m_model;
+  }
+
+  /**
+   * \brief Get the number of nodes in the table
+   * \return the number of nodes
+   */
+  uint32_t GetN (void) const
+  {
+    return m_n;
+  }
+
+private:
+  virtual double DoCalcRxPower (double txPowerDbm,
+                                Ptr<MobilityModel> a,
+                                Ptr<MobilityModel> b) const
+  {
+    std::unordered_map<const MobilityModel *, uint32_t>::const_iterator i = m_index.find (PeekPointer (a));
+    std::unordered_map<const MobilityModel *, uint32_t>::const_iterator j = m_index.find (PeekPointer (b));
+    if (i == m_index.end () || j == m_index.end ())
+      {
+        return m_model->CalcRxPower (txPowerDbm, a, b);
+      }
+    return txPowerDbm + m_gainDb[static_cast<size_t> (i->second) * m_n + j->second];
+  }
+
+  virtual int64_t DoAssignStreams (int64_t stream)
+  {
+    return 0;
+  }
+
+  Ptr<PropagationLossModel> m_model;  //!< Tabulated loss model
+  uint32_t m_n;                       //!< Number of nodes
+  std::vector<double> m_gainDb;       //!< Received minus transmitted power, row-major n * n
+  std::unordered_map<const MobilityModel *, uint32_t> m_index; //!< Row of each mobility model
+};
+
+NS_OBJECT_ENSURE_REGISTERED (LinkTablePropagationLossModel);
+
+} // namespace ns3
+
+#endif /* LINK_TABLE_H */
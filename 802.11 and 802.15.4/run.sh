@@ -1,15 +1,11 @@
-./waf --run "802.15_test --coverageArea=100"
-./waf --run "802.15_test --coverageArea=150"
-./waf --run "802.15_test --coverageArea=200"
-./waf --run "802.15_test --coverageArea=250"
-./waf --run "802.15_test --coverageArea=300"
+./waf build
+PROGRAM=$(ls build/scratch/ns3*-802.15_test-* | head -n 1)
 
-#write to csv
-python parser_802.15.4.py 802.15_coverageArea_100.xml 100
-python parser_802.15.4.py 802.15_coverageArea_150.xml 150
-python parser_802.15.4.py 802.15_coverageArea_200.xml 200
-python parser_802.15.4.py 802.15_coverageArea_250.xml 250
-python parser_802.15.4.py 802.15_coverageArea_300.xml 300
+#run all the coverage areas in parallel, one directory per run under sweep/
+./waf --run "sweep --program=$PROGRAM --out=sweep.csv coverageArea=100,150,200,250,300"
+
+#write to csv: coverageArea,Throughput,EndToEndDelay,DeliveryRatio,DropRatio
+tail -n +2 sweep.csv | cut -d, -f1,5-8 >> output.csv
 
 #plot
 gnuplot vary.code
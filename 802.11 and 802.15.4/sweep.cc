@@ -0,0 +1,359 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Parallel parameter sweep over the simulation programs of this repository
+// (802.15_test, 802.11_test, simulate).
+//
+// Every combination of the parameter grid is run once per seed, as an
+// independent process, with at most --jobs processes at a time:
+//
+//   ./waf --run "sweep --program=build/scratch/ns3.35-802.15_test-optimized
+//                --seeds=5 nodes=20,40,60,80,100 coverageArea=100,150,200"
+//
+// A grid parameter "name=v1,v2,..." is passed to the program as --name=v.
+// Each run works in its own directory, <dir>/run-<n>, so output files with
+// fixed names do not collide, and its stdout and stderr go to output.log
+// there. The seed is passed as NS_GLOBAL_VALUE="RngRun=<seed>".
+//
+// The result is one CSV file with a row per run: the parameters, the seed,
+// the exit status and the wall time, followed by the columns of the --result
+// file left by the run (a header line and a data line), if any.
+//
+// Running the driver through waf sets up the library path of the programs.
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct GridParameter
+{
+  std::string name;                 //!< Program option name, without "--"
+  std::vector<std::string> values;  //!< Values to sweep
+};
+
+struct Run
+{
+  std::vector<std::string> values;  //!< Value of each grid parameter
+  uint32_t seed;                    //!< RngRun
+  std::string dir;                  //!< Working directory
+  pid_t pid;                        //!< Process, while running
+  int status;                       //!< Exit status, -1 if killed by a signal
+  std::chrono::steady_clock::time_point start; //!< Start time
+  double seconds;                   //!< Wall time
+  std::string resultHeader;         //!< Header line of the result file
+  std::string resultRow;            //!< Data line of the result file
+};
+
+static std::vector<std::string>
+Split (const std::string &s, char sep)
+{
+  std::vector<std::string> out;
+  std::istringstream in (s);
+  std::string item;
+  while (std::getline (in, item, sep))
+    {
+      out.push_back (item);
+    }
+  return out;
+}
+
+static void
+Usage (const char *argv0)
+{
+  std::cerr << "Usage: " << argv0 << " --program=PATH [--jobs=N] [--seeds=N] [--out=FILE]\n"
+            << "          [--dir=DIR] [--result=FILE] name=v1,v2,... [name=...]\n"
+            << "  --program  simulation executable\n"
+            << "  --jobs     concurrent runs (default: number of cores)\n"
+            << "  --seeds    seeds per grid point, RngRun 1..N (default: 1)\n"
+            << "  --out      CSV file with one row per run (default: sweep.csv)\n"
+            << "  --dir      directory of the run directories (default: sweep)\n"
+            << "  --result   per-run result file appended to the rows (default: metrics.csv)\n";
+}
+
+static void
+Launch (Run &run, const std::string &program, const std::vector<GridParameter> &grid,
+        const std::string &resultFile)
+{
+  run.start = std::chrono::steady_clock::now ();
+  pid_t pid = fork ();
+  if (pid < 0)
+    {
+      std::perror ("fork");
+      std::exit (1);
+    }
+  if (pid > 0)
+    {
+      run.pid = pid;
+      return;
+    }
+
+  // Child
+  if (mkdir (run.dir.c_str (), 0755) != 0 && errno != EEXIST)
+    {
+      std::perror (run.dir.c_str ());
+      _exit (127);
+    }
+  if (chdir (run.dir.c_str ()) != 0)
+    {
+      std::perror (run.dir.c_str ());
+      _exit (127);
+    }
+  unlink (resultFile.c_str ()); // Left by an earlier sweep
+  int fd = open ("output.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0)
+    {
+      dup2 (fd, STDOUT_FILENO);
+      dup2 (fd, STDERR_FILENO);
+      close (fd);
+    }
+  std::string global = "RngRun=" + std::to_string (run.seed);
+  const char *inherited = std::getenv ("NS_GLOBAL_VALUE");
+  if (inherited != nullptr && *inherited != '\0')
+    {
+      global = std::string (inherited) + ";" + global;
+    }
+  setenv ("NS_GLOBAL_VALUE", global.c_str (), 1);
+
+  std::vector<std::string> args;
+  args.push_back (program);
+  for (size_t i = 0; i < grid.size (); ++i)
+    {
+      args.push_back ("--" + grid[i].name + "=" + run.values[i]);
+    }
+  std::vector<char *> argv;
+  for (std::string &a : args)
+    {
+      argv.push_back (&a[0]);
+    }
+  argv.push_back (nullptr);
+  execv (program.c_str (), argv.data ());
+  std::perror (program.c_str ());
+  _exit (127);
+}
+
+static void
+Collect (Run &run, const std::string &resultFile)
+{
+  std::ifstream in ((run.dir + "/" + resultFile).c_str ());
+  if (in.is_open ())
+    {
+      std::getline (in, run.resultHeader);
+      std::getline (in, run.resultRow);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string program;
+  uint32_t jobs = std::thread::hardware_concurrency ();
+  uint32_t seeds = 1;
+  std::string out = "sweep.csv";
+  std::string dir = "sweep";
+  std::string resultFile = "metrics.csv";
+  std::vector<GridParameter> grid;
+
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      size_t eq = arg.find ('=');
+      std::string key = arg.substr (0, eq);
+      std::string value = eq == std::string::npos ? "" : arg.substr (eq + 1);
+      if (key == "--program")
+        {
+          program = value;
+        }
+      else if (key == "--jobs")
+        {
+          jobs = std::stoul (value);
+        }
+      else if (key == "--seeds")
+        {
+          seeds = std::stoul (value);
+        }
+      else if (key == "--out")
+        {
+          out = value;
+        }
+      else if (key == "--dir")
+        {
+          dir = value;
+        }
+      else if (key == "--result")
+        {
+          resultFile = value;
+        }
+      else if (key.compare (0, 2, "--") != 0 && eq != std::string::npos && !value.empty ())
+        {
+          grid.push_back ({key, Split (value, ',')});
+        }
+      else
+        {
+          Usage (argv[0]);
+          return key == "--help" ? 0 : 1;
+        }
+    }
+  if (program.empty () || jobs == 0 || seeds == 0)
+    {
+      Usage (argv[0]);
+      return 1;
+    }
+
+  // The runs chdir to their own directory
+  char resolved[PATH_MAX];
+  if (realpath (program.c_str (), resolved) == nullptr)
+    {
+      std::perror (program.c_str ());
+      return 1;
+    }
+  program = resolved;
+  if (mkdir (dir.c_str (), 0755) != 0 && errno != EEXIST)
+    {
+      std::perror (dir.c_str ());
+      return 1;
+    }
+
+  // Cartesian product of the grid, the first parameter varying slowest
+  std::vector<Run> runs;
+  std::vector<size_t> index (grid.size (), 0);
+  bool done = false;
+  while (!done)
+    {
+      for (uint32_t seed = 1; seed <= seeds; ++seed)
+        {
+          Run run;
+          for (size_t p = 0; p < grid.size (); ++p)
+            {
+              run.values.push_back (grid[p].values[index[p]]);
+            }
+          run.seed = seed;
+          run.dir = dir + "/run-" + std::to_string (runs.size ());
+          run.pid = 0;
+          run.status = 0;
+          run.seconds = 0;
+          runs.push_back (run);
+        }
+      done = true;
+      for (size_t p = grid.size (); p-- > 0; )
+        {
+          if (++index[p] < grid[p].values.size ())
+            {
+              done = false;
+              break;
+            }
+          index[p] = 0;
+        }
+    }
+
+  std::cerr << runs.size () << " runs, " << jobs << " at a time" << std::endl;
+
+  std::map<pid_t, size_t> running;
+  size_t next = 0;
+  size_t finished = 0;
+  while (finished < runs.size ())
+    {
+      while (running.size () < jobs && next < runs.size ())
+        {
+          Launch (runs[next], program, grid, resultFile);
+          running[runs[next].pid] = next;
+          ++next;
+        }
+
+      int status;
+      pid_t pid = wait (&status);
+      if (pid < 0)
+        {
+          std::perror ("wait");
+          return 1;
+        }
+      auto it = running.find (pid);
+      if (it == running.end ())
+        {
+          continue;
+        }
+      Run &run = runs[it->second];
+      running.erase (it);
+      run.seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - run.start).count ();
+      run.status = WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+      Collect (run, resultFile);
+      ++finished;
+      std::cerr << "[" << finished << "/" << runs.size () << "] " << run.dir
+                << " exit " << run.status << ", " << run.seconds << " s" << std::endl;
+    }
+
+  // All the runs of a program write the same result columns
+  std::string resultHeader;
+  for (const Run &run : runs)
+    {
+      if (!run.resultHeader.empty ())
+        {
+          resultHeader = run.resultHeader;
+          break;
+        }
+    }
+  size_t resultColumns = resultHeader.empty () ? 0 : Split (resultHeader, ',').size ();
+
+  std::ofstream csv (out.c_str ());
+  if (!csv.is_open ())
+    {
+      std::perror (out.c_str ());
+      return 1;
+    }
+  for (const GridParameter &p : grid)
+    {
+      csv << p.name << ",";
+    }
+  csv << "seed,status,seconds";
+  if (resultColumns > 0)
+    {
+      csv << "," << resultHeader;
+    }
+  csv << "\n";
+  int failed = 0;
+  for (const Run &run : runs)
+    {
+      for (const std::string &v : run.values)
+        {
+          csv << v << ",";
+        }
+      csv << run.seed << "," << run.status << "," << run.seconds;
+      if (resultColumns > 0)
+        {
+          csv << "," << (run.resultRow.empty () ? std::string (resultColumns - 1, ',') : run.resultRow);
+        }
+      csv << "\n";
+      failed += run.status != 0;
+    }
+
+  std::cerr << failed << " of " << runs.size () << " runs failed, results in " << out << std::endl;
+  return failed == 0 ? 0 : 1;
+}
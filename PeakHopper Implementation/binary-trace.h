@@ -0,0 +1,209 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Buffered binary trace sink shared by simulate.cc and trace-convert.cc.
+//
+// The tracers append fixed-size records (time, flow, metric, value) to a
+// memory block that is written to disk only when it is full, instead of
+// formatting and flushing one text line per event. ConvertBinaryTrace ()
+// turns the file into the "<time> <flow 0> <flow 1> ..." .data files read by
+// the gnuplot scripts.
+
+#ifndef BINARY_TRACE_H
+#define BINARY_TRACE_H
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/nstime.h"
+
+/**
+ * Metrics written to the trace, in the order of TRACE_METRIC_NAMES
+ */
+enum TraceMetric : uint32_t
+{
+  TRACE_CWND = 0,
+  TRACE_SSTHRESH,
+  TRACE_RTT,
+  TRACE_RTO,
+  TRACE_RTO_BY_RTT,
+  TRACE_MEAN_RETRANSMISSION,
+  TRACE_METRIC_COUNT
+};
+
+/**
+ * Name of the .data file of each metric, without prefix and extension
+ */
+static const char * const TRACE_METRIC_NAMES[TRACE_METRIC_COUNT] = {
+  "cwnd", "ssth", "rtt", "rto", "rto_by_rtt", "mean_retransmission"
+};
+
+static const uint32_t TRACE_MAGIC = 0x52544850;   //!< "PHTR"
+static const uint32_t TRACE_VERSION = 2;          //!< File layout version
+
+/**
+ * One trace event, 24 bytes on disk
+ */
+struct TraceRecord
+{
+  int64_t  time;    //!< Simulation time in nanoseconds
+  uint32_t flow;    //!< Flow (socket) the event belongs to
+  uint32_t metric;  //!< TraceMetric
+  double   value;   //!< New value of the metric
+};
+
+/**
+ * \brief Append-only binary trace file, written in large blocks
+ */
+class BinaryTraceWriter
+{
+public:
+  /**
+   * \brief Open the trace file and write its header
+   * \param fileName the trace file
+   * \param nFlows number of flows, records use flow ids 0 .. nFlows - 1
+   * \param blockRecords number of records buffered between two writes
+   */
+  BinaryTraceWriter (const std::string &fileName, uint32_t nFlows = 1,
+                     size_t blockRecords = 1 << 16)
+    : m_out (fileName.c_str (), std::ios::out | std::ios::binary)
+  {
+    NS_ABORT_MSG_UNLESS (m_out.is_open (), "Cannot open " << fileName);
+    m_block.reserve (blockRecords);
+    uint32_t header[3] = {TRACE_MAGIC, TRACE_VERSION, nFlows};
+    m_out.write (reinterpret_cast<const char *> (header), sizeof (header));
+  }
+
+  ~BinaryTraceWriter ()
+  {
+    Close ();
+  }
+
+  /**
+   * \brief Record a new value of a metric
+   * \param t the time of the event
+   * \param flow the flow of the event
+   * \param metric the metric
+   * \param value the new value
+   */
+  void Append (ns3::Time t, uint32_t flow, TraceMetric metric, double value)
+  {
+    m_block.push_back ({t.GetNanoSeconds (), flow, metric, value});
+    if (m_block.size () == m_block.capacity ())
+      {
+        Flush ();
+      }
+  }
+
+  /**
+   * \brief Write the buffered records to the file
+   */
+  void Flush (void)
+  {
+    if (!m_block.empty ())
+      {
+        m_out.write (reinterpret_cast<const char *> (m_block.data ()),
+                     m_block.size () * sizeof (TraceRecord));
+        m_block.clear ();
+      }
+  }
+
+  /**
+   * \brief Write the buffered records and close the file
+   */
+  void Close (void)
+  {
+    if (m_out.is_open ())
+      {
+        Flush ();
+        m_out.close ();
+      }
+  }
+
+private:
+  std::ofstream            m_out;    //!< Trace file
+  std::vector<TraceRecord> m_block;  //!< Records not written yet
+};
+
+/**
+ * \brief Convert a binary trace into "<prefix><metric>.data" text files
+ *
+ * Each file holds one "<time in s> <flow 0> <flow 1> ..." line per record
+ * of its metric. The flow of the record gets its new value, the other
+ * columns repeat their last one, or NaN before their first record. With a
+ * single flow this is the format the tracers of simulate.cc used to write
+ * directly.
+ *
+ * \param input the binary trace file
+ * \param prefix prefix of the .data files
+ */
+inline void
+ConvertBinaryTrace (const std::string &input, const std::string &prefix)
+{
+  std::ifstream in (input.c_str (), std::ios::in | std::ios::binary);
+  NS_ABORT_MSG_UNLESS (in.is_open (), "Cannot open " << input);
+  uint32_t header[3];
+  in.read (reinterpret_cast<char *> (header), sizeof (header));
+  NS_ABORT_MSG_UNLESS (in && header[0] == TRACE_MAGIC && header[1] == TRACE_VERSION,
+                       input << " is not a version " << TRACE_VERSION << " trace");
+  uint32_t nFlows = header[2];
+
+  std::ofstream out[TRACE_METRIC_COUNT];
+  std::vector<double> last[TRACE_METRIC_COUNT];
+  for (uint32_t m = 0; m < TRACE_METRIC_COUNT; ++m)
+    {
+      out[m].open ((prefix + TRACE_METRIC_NAMES[m] + ".data").c_str ());
+      last[m].assign (nFlows, std::numeric_limits<double>::quiet_NaN ());
+    }
+
+  std::vector<TraceRecord> block (1 << 16);
+  while (in)
+    {
+      in.read (reinterpret_cast<char *> (block.data ()), block.size () * sizeof (TraceRecord));
+      size_t n = in.gcount () / sizeof (TraceRecord);
+      for (size_t i = 0; i < n; ++i)
+        {
+          const TraceRecord &r = block[i];
+          NS_ABORT_MSG_UNLESS (r.metric < TRACE_METRIC_COUNT && r.flow < nFlows,
+                               "Bad record, metric " << r.metric << " flow " << r.flow);
+          std::vector<double> &values = last[r.metric];
+          values[r.flow] = r.value;
+          std::ostream &os = out[r.metric];
+          os << r.time * 1e-9;
+          for (double v : values)
+            {
+              os << " ";
+              if (std::isnan (v))
+                {
+                  os << "NaN";
+                }
+              else
+                {
+                  os << v;
+                }
+            }
+          os << '\n';
+        }
+    }
+}
+
+#endif /* BINARY_TRACE_H */
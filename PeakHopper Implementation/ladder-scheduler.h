@@ -0,0 +1,272 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Ladder queue event scheduler, shared by simulate.cc and
+// scheduler-bench.cc (copy it into scratch/ next to them).
+//
+// TCP keeps re-arming timers that almost never fire: every ACK cancels the
+// retransmission timeout and schedules a new one an RTO later, and the
+// delayed ACK timer and pacing do the same. With the default MapScheduler
+// each of these costs a tree insertion, and the cancelled events stay in
+// the tree until their time comes.
+//
+// LadderScheduler (Tang, Goh and Thng, "Ladder queue: An O(1) priority
+// queue structure for large-scale discrete event simulation", 2005) keeps
+// three tiers:
+//
+// - Top: far-future events, appended unsorted in O(1);
+// - Rung: buckets of equal width, built from Top once Bottom runs dry;
+// - Bottom: a binary heap holding the events of the current bucket.
+//
+// Most RTO events are inserted into Top and cancelled before Bottom reaches
+// them. Cancelled events are dropped when Top or a bucket is spread out,
+// so they are never sorted. Events with equal times leave in the order of
+// their uid, as with the other schedulers, so a simulation gives the same
+// results with any of them.
+
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "ns3/assert.h"
+#include "ns3/event-impl.h"
+#include "ns3/scheduler.h"
+
+namespace ns3 {
+
+/**
+ * \brief Ladder queue scheduler with lazy removal of cancelled events
+ */
+class LadderScheduler : public Scheduler
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::LadderScheduler")
+      .SetParent<Scheduler> ()
+      .SetGroupName ("Core")
+      .AddConstructor<LadderScheduler> ()
+    ;
+    return tid;
+  }
+
+  LadderScheduler ()
+    : m_topStart (0),
+      m_rungStart (0),
+      m_width (1),
+      m_current (0),
+      m_boundary (0)
+  {
+  }
+
+  virtual ~LadderScheduler ()
+  {
+  }
+
+  virtual void Insert (const Event &ev)
+  {
+    Place (ev);
+    Refill ();
+  }
+
+  virtual bool IsEmpty (void) const
+  {
+    return m_bottom.empty ();
+  }
+
+  virtual Event PeekNext (void) const
+  {
+    return m_bottom.front ();
+  }
+
+  virtual Event RemoveNext (void)
+  {
+    std::pop_heap (m_bottom.begin (), m_bottom.end (), Later);
+    Event ev = m_bottom.back ();
+    m_bottom.pop_back ();
+    Refill ();
+    return ev;
+  }
+
+  virtual void Remove (const Event &ev)
+  {
+    if (!Erase (m_bottom, ev))
+      {
+        bool found = false;
+        for (size_t i = m_current; i < m_rung.size () && !found; ++i)
+          {
+            found = Erase (m_rung[i], ev);
+          }
+        if (!found)
+          {
+            found = Erase (m_top, ev);
+          }
+        NS_ASSERT_MSG (found, "Event " << ev.key.m_uid << " not scheduled");
+      }
+    else
+      {
+        std::make_heap (m_bottom.begin (), m_bottom.end (), Later);
+      }
+    Refill ();
+  }
+
+private:
+  /// Heap order, earliest event at the front
+  static bool Later (const Event &a, const Event &b)
+  {
+    return b < a;
+  }
+
+  /// Remove an event from a tier by uid, without keeping the order
+  static bool Erase (std::vector<Event> &tier, const Event &ev)
+  {
+    for (size_t i = 0; i < tier.size (); ++i)
+      {
+        if (tier[i].key.m_uid == ev.key.m_uid)
+          {
+            tier[i] = tier.back ();
+            tier.pop_back ();
+            return true;
+          }
+      }
+    return false;
+  }
+
+  /// Put an event in the tier that covers its time
+  void Place (const Event &ev)
+  {
+    uint64_t ts = ev.key.m_ts;
+    if (ts < m_boundary)
+      {
+        m_bottom.push_back (ev);
+        std::push_heap (m_bottom.begin (), m_bottom.end (), Later);
+      }
+    else if (ts < m_topStart)
+      {
+        m_rung[(ts - m_rungStart) / m_width].push_back (ev);
+      }
+    else
+      {
+        m_top.push_back (ev);
+      }
+  }
+
+  /**
+   * \brief Move the live events of a bucket into Bottom
+   * \param bucket the events, left empty
+   */
+  void Spread (std::vector<Event> &bucket)
+  {
+    for (size_t i = 0; i < bucket.size (); ++i)
+      {
+        if (bucket[i].impl->IsCancelled ())
+          {
+            // The simulator would only unref it when popped
+            bucket[i].impl->Unref ();
+          }
+        else
+          {
+            m_bottom.push_back (bucket[i]);
+          }
+      }
+    bucket.clear ();
+    std::make_heap (m_bottom.begin (), m_bottom.end (), Later);
+  }
+
+  /// Spread Top over a new rung of buckets
+  void BuildRung (void)
+  {
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    size_t live = 0;
+    for (size_t i = 0; i < m_top.size (); ++i)
+      {
+        if (m_top[i].impl->IsCancelled ())
+          {
+            m_top[i].impl->Unref ();
+            continue;
+          }
+        m_top[live++] = m_top[i];
+        min = std::min (min, m_top[i].key.m_ts);
+        max = std::max (max, m_top[i].key.m_ts);
+      }
+    m_top.resize (live);
+    if (live == 0)
+      {
+        return;
+      }
+
+    size_t buckets = std::min<size_t> (live, 1 << 16);
+    m_rungStart = min;
+    m_width = (max - min) / buckets + 1;
+    m_topStart = min + m_width * buckets;
+    m_current = 0;
+    m_boundary = min;
+    m_rung.resize (buckets);
+    for (size_t i = 0; i < m_top.size (); ++i)
+      {
+        m_rung[(m_top[i].key.m_ts - min) / m_width].push_back (m_top[i]);
+      }
+    m_top.clear ();
+  }
+
+  /// Make sure that Bottom holds the earliest events, if there are any
+  void Refill (void)
+  {
+    while (m_bottom.empty ())
+      {
+        while (m_current < m_rung.size () && m_bottom.empty ())
+          {
+            m_boundary = m_rungStart + m_width * (m_current + 1);
+            Spread (m_rung[m_current++]);
+          }
+        if (!m_bottom.empty ())
+          {
+            return;
+          }
+        // Rung exhausted, everything before Top now goes to Bottom
+        m_boundary = m_topStart;
+        if (m_top.empty ())
+          {
+            return;
+          }
+        BuildRung ();
+      }
+  }
+
+  std::vector<Event> m_top;                //!< Far-future events, unsorted
+  std::vector<std::vector<Event> > m_rung; //!< Buckets of m_width time steps
+  std::vector<Event> m_bottom;             //!< Heap of the events before m_boundary
+  uint64_t m_topStart;                     //!< Events from this time go to Top
+  uint64_t m_rungStart;                    //!< Start of the first bucket
+  uint64_t m_width;                        //!< Bucket width, in time steps
+  size_t m_current;                        //!< Next bucket to spread
+  uint64_t m_boundary;                     //!< End of the spread buckets
+};
+
+NS_OBJECT_ENSURE_REGISTERED (LadderScheduler);
+
+} // namespace ns3
+
+#endif /* LADDER_SCHEDULER_H */
@@ -0,0 +1,161 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Regression check of TcpSocketBase::LazyRetxTimer.
+//
+// One bulk flow crosses a lossy dumbbell (access links and bottleneck as in
+// simulate.cc). The same run is made with LazyRetxTimer false and true, and
+// the time of every retransmission timeout of the sender (the RtoExpired
+// trace source) is recorded. The two lists must be identical; the program
+// prints the first difference and exits with status 1 otherwise.
+//
+// The error model draws from a fixed stream, so that both runs of a seed
+// lose the same packets:
+//
+//   ./waf --run "scratch/lazy-retx-check --seeds=10 --error_p=0.02"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("LazyRetxCheck");
+
+static std::vector<Time> g_timeouts;
+
+static void
+RtoExpired (Time rto)
+{
+  g_timeouts.push_back (Simulator::Now ());
+}
+
+static void
+TraceSender (void)
+{
+  Config::ConnectWithoutContext ("/NodeList/0/$ns3::TcpL4Protocol/SocketList/0/RtoExpired",
+                                 MakeCallback (&RtoExpired));
+}
+
+/**
+ * \brief Run the flow once
+ * \param lazy value of LazyRetxTimer
+ * \param seed run number of the random streams
+ * \param errorP packet error rate of the bottleneck
+ * \param duration simulated time in seconds
+ * \return the times of the retransmission timeouts
+ */
+static std::vector<Time>
+RunFlow (bool lazy, uint32_t seed, double errorP, double duration)
+{
+  Config::SetDefault ("ns3::TcpSocketBase::LazyRetxTimer", BooleanValue (lazy));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (340));
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (seed);
+  g_timeouts.clear ();
+
+  // source - left gateway - right gateway - sink
+  NodeContainer nodes;
+  nodes.Create (4);
+
+  PointToPointHelper access;
+  access.SetDeviceAttribute ("DataRate", StringValue ("2Mbps"));
+  access.SetChannelAttribute ("Delay", StringValue ("85ms"));
+  PointToPointHelper bottleneck;
+  bottleneck.SetDeviceAttribute ("DataRate", StringValue ("10Mbps"));
+  bottleneck.SetChannelAttribute ("Delay", StringValue ("50ms"));
+
+  Ptr<RateErrorModel> error = CreateObject<RateErrorModel> ();
+  error->SetUnit (RateErrorModel::ERROR_UNIT_PACKET);
+  error->SetRate (errorP);
+  error->AssignStreams (0);
+  bottleneck.SetDeviceAttribute ("ReceiveErrorModel", PointerValue (error));
+
+  NetDeviceContainer left = access.Install (nodes.Get (0), nodes.Get (1));
+  NetDeviceContainer middle = bottleneck.Install (nodes.Get (1), nodes.Get (2));
+  NetDeviceContainer right = access.Install (nodes.Get (2), nodes.Get (3));
+
+  InternetStackHelper stack;
+  stack.InstallAll ();
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.255.255.0");
+  address.Assign (left);
+  address.NewNetwork ();
+  address.Assign (middle);
+  address.NewNetwork ();
+  Ipv4InterfaceContainer sink = address.Assign (right);
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  uint16_t port = 50000;
+  BulkSendHelper ftp ("ns3::TcpSocketFactory", InetSocketAddress (sink.GetAddress (1), port));
+  ApplicationContainer sourceApp = ftp.Install (nodes.Get (0));
+  sourceApp.Start (Seconds (0));
+  PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+  ApplicationContainer sinkApp = sinkHelper.Install (nodes.Get (3));
+  sinkApp.Start (Seconds (0));
+  Simulator::Schedule (MilliSeconds (1), &TraceSender);
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  return g_timeouts;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t seeds = 5;
+  double errorP = 0.02;
+  double duration = 60;
+
+  CommandLine cmd;
+  cmd.AddValue ("seeds", "Number of seeds to check", seeds);
+  cmd.AddValue ("error_p", "Packet error rate of the bottleneck", errorP);
+  cmd.AddValue ("duration", "Simulated time of each run in seconds", duration);
+  cmd.Parse (argc, argv);
+
+  uint64_t total = 0;
+  for (uint32_t seed = 1; seed <= seeds; ++seed)
+    {
+      std::vector<Time> eager = RunFlow (false, seed, errorP, duration);
+      std::vector<Time> lazy = RunFlow (true, seed, errorP, duration);
+      for (size_t i = 0; i < std::max (eager.size (), lazy.size ()); ++i)
+        {
+          if (i >= eager.size () || i >= lazy.size () || eager[i] != lazy[i])
+            {
+              std::cout << "seed " << seed << ": timeout " << i << " at "
+                        << (i < eager.size () ? eager[i].GetSeconds () : -1) << " s without LazyRetxTimer, "
+                        << (i < lazy.size () ? lazy[i].GetSeconds () : -1) << " s with it" << std::endl;
+              return 1;
+            }
+        }
+      std::cout << "seed " << seed << ": " << eager.size () << " timeouts, identical" << std::endl;
+      total += eager.size ();
+    }
+  if (total == 0)
+    {
+      std::cout << "No retransmission timeout, raise --error_p or --duration" << std::endl;
+      return 1;
+    }
+  return 0;
+}
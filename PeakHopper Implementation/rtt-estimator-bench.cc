@@ -0,0 +1,304 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Micro-benchmark suite for the RTT estimators.
+//
+// Every RTT sample stream is fed through every estimator variant:
+//
+// - IntegerUpdate:        RttMeanDeviation, alpha = 1/8, beta = 1/4
+// - FloatingPointUpdate:  RttMeanDeviation, alpha/beta just off a power of two
+// - PeakHopper-fixed:     RttMeanDeviation, PeakHopper, Q16 update
+// - PeakHopper-float:     RttMeanDeviation, PeakHopper, floating point update
+// - Quantile:             RttQuantile, 0.99 quantile
+//
+// Sample streams are synthetic (steady, spiky, bimodal, delay spikes between
+// the 85 ms and 175 ms access paths of simulate.cc) or recorded, read from a
+// "<time> <rtt in seconds>" file such as the rtt.data written by simulate.cc.
+//
+// For each pair the program reports the cost of Measurement () in ns/sample,
+// the heap allocations per sample, and how well the resulting RTO predicts
+// the next sample: the fraction of samples above the RTO (a spurious
+// timeout) and the mean RTO/RTT ratio otherwise.
+//
+// Build with the optimized profile, otherwise NS_LOG_FUNCTION dominates:
+//
+//   ./waf configure --build-profile=optimized
+//   ./waf --run "scratch/rtt-estimator-bench --samples=1000000 --trace=rtt.data"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/tcp-rto-ops.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("RttEstimatorBench");
+
+// Heap allocation counter, used to report allocations/sample
+static uint64_t g_allocations = 0;
+
+void *
+operator new (std::size_t size)
+{
+  ++g_allocations;
+  void *p = std::malloc (size == 0 ? 1 : size);
+  if (p == nullptr)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+struct EstimatorVariant
+{
+  std::string name;     //!< Printed name
+  std::string type;     //!< RttEstimator TypeId
+  double alpha;         //!< RttMeanDeviation::Alpha
+  double beta;          //!< RttMeanDeviation::Beta
+  bool peakHopper;      //!< RttMeanDeviation::m_peakHopper
+  bool integerUpdate;   //!< RttMeanDeviation::PeakHopperIntegerUpdate
+  std::string rtoType;  //!< TcpRtoOps used for the accuracy figures
+};
+
+struct SampleStream
+{
+  std::string name;         //!< Printed name
+  std::vector<Time> samples; //!< RTT samples
+};
+
+static Ptr<RttEstimator>
+CreateEstimator (const EstimatorVariant &v)
+{
+  ObjectFactory factory;
+  factory.SetTypeId (v.type);
+  if (v.type == "ns3::RttMeanDeviation")
+    {
+      factory.Set ("Alpha", DoubleValue (v.alpha));
+      factory.Set ("Beta", DoubleValue (v.beta));
+      factory.Set ("m_peakHopper", BooleanValue (v.peakHopper));
+      factory.Set ("PeakHopperIntegerUpdate", BooleanValue (v.integerUpdate));
+    }
+  return factory.Create<RttEstimator> ();
+}
+
+static void
+RunVariant (const SampleStream &stream, const EstimatorVariant &v, Time minRto)
+{
+  const std::vector<Time> &samples = stream.samples;
+
+  // Cost of the update alone
+  Ptr<RttEstimator> rtt = CreateEstimator (v);
+  uint64_t allocations = g_allocations;
+  auto start = std::chrono::steady_clock::now ();
+  for (const Time &m : samples)
+    {
+      rtt->Measurement (m);
+    }
+  auto stop = std::chrono::steady_clock::now ();
+  allocations = g_allocations - allocations;
+  double ns = std::chrono::duration<double, std::nano> (stop - start).count ();
+
+  // Accuracy of the RTO armed after sample i against sample i + 1
+  rtt = CreateEstimator (v);
+  ObjectFactory rtoFactory;
+  rtoFactory.SetTypeId (v.rtoType);
+  Ptr<TcpRtoOps> rto = rtoFactory.Create<TcpRtoOps> ();
+  uint64_t spurious = 0;
+  uint64_t covered = 0;
+  double ratioSum = 0.0;
+  for (size_t i = 0; i + 1 < samples.size (); ++i)
+    {
+      rtt->Measurement (samples[i]);
+      rto->RttSample (rtt, samples[i]);
+      Time timeout = rto->GetRto (rtt, MilliSeconds (1), minRto);
+      if (samples[i + 1] > timeout)
+        {
+          ++spurious;
+        }
+      else
+        {
+          ++covered;
+          ratioSum += timeout.GetSeconds () / samples[i + 1].GetSeconds ();
+        }
+    }
+
+  size_t n = samples.size ();
+  std::cout << std::left << std::setw (14) << stream.name
+            << std::setw (22) << v.name
+            << std::right << std::fixed
+            << std::setw (10) << std::setprecision (2) << ns / n
+            << std::setw (10) << std::setprecision (3) << static_cast<double> (allocations) / n
+            << std::setw (12) << std::setprecision (4) << (n > 1 ? 100.0 * spurious / (n - 1) : 0.0)
+            << std::setw (12) << std::setprecision (3) << (covered ? ratioSum / covered : 0.0)
+            << std::endl;
+}
+
+static SampleStream
+Steady (uint32_t n, Ptr<UniformRandomVariable> u)
+{
+  SampleStream s {"steady", {}};
+  s.samples.reserve (n);
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      s.samples.push_back (MilliSeconds (440) + MicroSeconds (u->GetInteger (0, 2000)));
+    }
+  return s;
+}
+
+static SampleStream
+Spiky (uint32_t n, Ptr<UniformRandomVariable> u)
+{
+  // 1% of the samples carry an extra 300 ms of queueing
+  SampleStream s {"spiky", {}};
+  s.samples.reserve (n);
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      Time m = MilliSeconds (440) + MicroSeconds (u->GetInteger (0, 2000));
+      if (u->GetValue () < 0.01)
+        {
+          m += MilliSeconds (300);
+        }
+      s.samples.push_back (m);
+    }
+  return s;
+}
+
+static SampleStream
+Bimodal (uint32_t n, Ptr<UniformRandomVariable> u)
+{
+  // Round trips through the 85 ms and the 175 ms access links, 50 ms bottleneck
+  SampleStream s {"bimodal", {}};
+  s.samples.reserve (n);
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      Time base = u->GetValue () < 0.5 ? MilliSeconds (440) : MilliSeconds (800);
+      s.samples.push_back (base + MicroSeconds (u->GetInteger (0, 5000)));
+    }
+  return s;
+}
+
+static SampleStream
+DelaySpikes (uint32_t n, Ptr<UniformRandomVariable> u)
+{
+  // Mostly on the 85 ms path; every ~500 samples a 50-sample burst on the 175 ms path
+  SampleStream s {"delay-spikes", {}};
+  s.samples.reserve (n);
+  uint32_t burst = 0;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      if (burst == 0 && u->GetValue () < 1.0 / 500)
+        {
+          burst = 50;
+        }
+      Time base = MilliSeconds (440);
+      if (burst > 0)
+        {
+          base = MilliSeconds (800);
+          --burst;
+        }
+      s.samples.push_back (base + MicroSeconds (u->GetInteger (0, 2000)));
+    }
+  return s;
+}
+
+static SampleStream
+Recorded (const std::string &fileName)
+{
+  SampleStream s {"recorded", {}};
+  std::ifstream in (fileName.c_str ());
+  NS_ABORT_MSG_UNLESS (in.is_open (), "Cannot open " << fileName);
+  double t;
+  double rtt;
+  while (in >> t >> rtt)
+    {
+      if (rtt > 0)
+        {
+          s.samples.push_back (Seconds (rtt));
+        }
+    }
+  return s;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nSamples = 1000000;
+  std::string trace = "";
+  Time minRto = MilliSeconds (200);
+
+  CommandLine cmd;
+  cmd.AddValue ("samples", "Number of samples of each synthetic stream", nSamples);
+  cmd.AddValue ("trace", "Recorded RTT trace (\"<time> <rtt in s>\" lines), e.g. rtt.data", trace);
+  cmd.AddValue ("minRto", "MinRto used for the RFC 6298 accuracy figures", minRto);
+  cmd.Parse (argc, argv);
+
+  Ptr<UniformRandomVariable> u = CreateObject<UniformRandomVariable> ();
+  u->SetStream (1);
+
+  std::vector<SampleStream> streams;
+  streams.push_back (Steady (nSamples, u));
+  streams.push_back (Spiky (nSamples, u));
+  streams.push_back (Bimodal (nSamples, u));
+  streams.push_back (DelaySpikes (nSamples, u));
+  if (!trace.empty ())
+    {
+      streams.push_back (Recorded (trace));
+    }
+
+  std::vector<EstimatorVariant> variants;
+  variants.push_back ({"IntegerUpdate", "ns3::RttMeanDeviation", 0.125, 0.25, false, true, "ns3::TcpRtoRfc6298"});
+  variants.push_back ({"FloatingPointUpdate", "ns3::RttMeanDeviation", 0.1249, 0.2499, false, true, "ns3::TcpRtoRfc6298"});
+  variants.push_back ({"PeakHopper-fixed", "ns3::RttMeanDeviation", 0.125, 0.25, true, true, "ns3::TcpRtoPeakHopper"});
+  variants.push_back ({"PeakHopper-float", "ns3::RttMeanDeviation", 0.125, 0.25, true, false, "ns3::TcpRtoPeakHopper"});
+  variants.push_back ({"Quantile", "ns3::RttQuantile", 0, 0, false, false, "ns3::TcpRtoRfc6298"});
+
+  std::cout << std::left << std::setw (14) << "stream"
+            << std::setw (22) << "estimator"
+            << std::right
+            << std::setw (10) << "ns/smpl"
+            << std::setw (10) << "allocs"
+            << std::setw (12) << "spurious%"
+            << std::setw (12) << "RTO/RTT" << std::endl;
+  for (const SampleStream &s : streams)
+    {
+      for (const EstimatorVariant &v : variants)
+        {
+          RunVariant (s, v, minRto);
+        }
+    }
+
+  return 0;
+}
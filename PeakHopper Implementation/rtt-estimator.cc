@@ -25,6 +25,7 @@
 // Base class allows variations of round trip time estimators to be
 // implemented
 
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 
@@ -32,6 +33,7 @@
 #include "ns3/double.h"
 #include "ns3/log.h"
 #include "ns3/boolean.h"
+#include "ns3/uinteger.h"
 
 namespace ns3 {
 
@@ -41,6 +43,8 @@ NS_OBJECT_ENSURE_REGISTERED (RttEstimator);
 
 /// Tolerance used to check reciprocal of two numbers.
 static const double TOLERANCE = 1e-6;
+/// Fractional bits of the fixed-point PeakHopper gain (Q16).
+static const uint32_t GAIN_SHIFT = 16;
 //static  double m_gain = 0.0;
 
 TypeId 
@@ -116,12 +120,31 @@ void RttEstimator::Reset ()
   m_nSamples = 0;
 }
 
+void
+RttEstimator::Seed (Time estimate, Time variation)
+{
+  NS_LOG_FUNCTION (this << estimate << variation);
+  m_estimatedRtt = estimate;
+  m_estimatedVariation = variation;
+  m_nSamples = std::max (m_nSamples, 1U);
+}
+
 uint32_t 
 RttEstimator::GetNSamples (void) const
 {
   return m_nSamples;
 }
 
+void
+RttEstimator::MeasurementBatch (const std::vector<Time> &samples)
+{
+  NS_LOG_FUNCTION (this << samples.size ());
+  for (std::vector<Time>::const_iterator it = samples.begin (); it != samples.end (); ++it)
+    {
+      Measurement (*it);
+    }
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // Mean-Deviation Estimator
@@ -153,7 +176,12 @@ RttMeanDeviation::GetTypeId (void)
     .AddAttribute ("m_peakHopper", "Enable or disable peakHopper option",
                    BooleanValue (false),
                    MakeBooleanAccessor (&RttMeanDeviation::m_peakHopper),
-                   MakeBooleanChecker ());
+                   MakeBooleanChecker ())
+    .AddAttribute ("PeakHopperIntegerUpdate",
+                   "Use the fixed-point (Q16 gain) PeakHopper update instead of the floating point one",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&RttMeanDeviation::m_integerPeakHopper),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
@@ -164,7 +192,8 @@ RttMeanDeviation::RttMeanDeviation()
 }
 
 RttMeanDeviation::RttMeanDeviation (const RttMeanDeviation& c)
-  : RttEstimator (c), m_alpha (c.m_alpha), m_beta (c.m_beta)
+  : RttEstimator (c), m_gain (c.m_gain), m_alpha (c.m_alpha), m_beta (c.m_beta),
+    m_peakHopper (c.m_peakHopper), m_integerPeakHopper (c.m_integerPeakHopper)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -250,29 +279,79 @@ RttMeanDeviation::FloatingPointUpdatePeakHopper (Time m)
 }
 
 
-void
-RttMeanDeviation::IntegerUpdate (Time m, uint32_t rttShift, uint32_t variationShift)
+/**
+ * One step of the Jacobson/Karels filter on raw ticks.
+ *
+ * \param meas the measurement
+ * \param srtt the rtt estimate, updated in place
+ * \param rttvar the variation estimate, updated in place
+ * \param rttShift log base 2 (1/alpha)
+ * \param variationShift log base 2 (1/beta)
+ */
+static inline void
+JacobsonStep (int64_t meas, int64_t &srtt, int64_t &rttvar,
+              uint32_t rttShift, uint32_t variationShift)
 {
-  NS_LOG_FUNCTION (this << m << rttShift << variationShift);
   // Jacobson/Karels paper appendix A.2
-  int64_t meas = m.GetInteger ();
-  int64_t delta = meas - m_estimatedRtt.GetInteger ();
-  int64_t srtt = (m_estimatedRtt.GetInteger () << rttShift) + delta;
-  m_estimatedRtt = Time::From (srtt >> rttShift);
+  int64_t delta = meas - srtt;
+  srtt = ((srtt << rttShift) + delta) >> rttShift;
   if (delta < 0)
     {
       delta = -delta;
     }
-  delta -= m_estimatedVariation.GetInteger ();
-  int64_t rttvar = m_estimatedVariation.GetInteger () << variationShift;
-  rttvar += delta;
-  m_estimatedVariation = Time::From (rttvar >> variationShift);
+  delta -= rttvar;
+  rttvar = ((rttvar << variationShift) + delta) >> variationShift;
+}
+
+/**
+ * One step of the PeakHopper filter on raw ticks.
+ *
+ * \param meas the measurement
+ * \param srtt the rtt estimate, updated in place
+ * \param rttvar the variation estimate, updated in place
+ * \param gain Q16 gain
+ * \param gainSquared Q16 square of the gain, used on negative deviations
+ */
+static inline void
+PeakHopperStep (int64_t meas, int64_t &srtt, int64_t &rttvar,
+                int64_t gain, int64_t gainSquared)
+{
+  int64_t err = meas - srtt;
+  int64_t difference = err - rttvar;
+  int64_t g = difference < 0 ? gainSquared : gain;
+  srtt += (err * g) >> GAIN_SHIFT;
+  if (err >= 0)
+    {
+      rttvar += (difference * g) >> GAIN_SHIFT;
+    }
+}
+
+void
+RttMeanDeviation::IntegerUpdatePeakHopper (Time m)
+{
+  NS_LOG_FUNCTION (this << m);
+  // Same filter as FloatingPointUpdatePeakHopper, on raw ticks with a
+  // Q16 fixed-point gain
+  int64_t gain = static_cast<int64_t> (m_gain * (1 << GAIN_SHIFT) + 0.5);
+  int64_t srtt = m_estimatedRtt.GetInteger ();
+  int64_t rttvar = m_estimatedVariation.GetInteger ();
+  PeakHopperStep (m.GetInteger (), srtt, rttvar, gain, (gain * gain) >> GAIN_SHIFT);
+  m_estimatedRtt = Time::From (srtt);
+  m_estimatedVariation = Time::From (rttvar);
   return;
 }
 
-//double prev_alpha = 1/8;
-//double prev_beta = 1/4;
-Time pr(0.1);
+void
+RttMeanDeviation::IntegerUpdate (Time m, uint32_t rttShift, uint32_t variationShift)
+{
+  NS_LOG_FUNCTION (this << m << rttShift << variationShift);
+  int64_t srtt = m_estimatedRtt.GetInteger ();
+  int64_t rttvar = m_estimatedVariation.GetInteger ();
+  JacobsonStep (m.GetInteger (), srtt, rttvar, rttShift, variationShift);
+  m_estimatedRtt = Time::From (srtt);
+  m_estimatedVariation = Time::From (rttvar);
+  return;
+}
 
 void 
 RttMeanDeviation::Measurement (Time m)
@@ -280,32 +359,35 @@ RttMeanDeviation::Measurement (Time m)
   NS_LOG_FUNCTION (this << m);
   if (m_nSamples)
     { 
-      // If both alpha and beta are reciprocal powers of two, updating can
-      // be done with integer arithmetic according to Jacobson/Karels paper.
-      // If not, since class Time only supports integer multiplication,
-      // must convert Time to floating point and back again
-        
-        if(m_peakHopper){
-          double del = ((m.GetSeconds()-pr.GetSeconds())/pr.GetSeconds());
-          if(del>1)del = 1.0;
-          
-          m_alpha = (1/8)*(1+del);
-          m_beta = (1/4)*(1-del);
-          
+      if (m_peakHopper)
+        {
+          // The PeakHopper filter only depends on m_gain
+          if (m_integerPeakHopper)
+            {
+              IntegerUpdatePeakHopper (m);
+            }
+          else
+            {
+              FloatingPointUpdatePeakHopper (m);
+            }
+        }
+      else
+        {
+          // If both alpha and beta are reciprocal powers of two, updating can
+          // be done with integer arithmetic according to Jacobson/Karels paper.
+          // If not, since class Time only supports integer multiplication,
+          // must convert Time to floating point and back again
+          uint32_t rttShift = CheckForReciprocalPowerOfTwo (m_alpha);
+          uint32_t variationShift = CheckForReciprocalPowerOfTwo (m_beta);
+          if (rttShift && variationShift)
+            {
+              IntegerUpdate (m, rttShift, variationShift);
+            }
+          else
+            {
+              FloatingPointUpdate (m);
+            }
         }
-        
-        uint32_t rttShift = CheckForReciprocalPowerOfTwo (m_alpha);
-        uint32_t variationShift = CheckForReciprocalPowerOfTwo (m_beta);
-        if (rttShift && variationShift)
-          {
-            //NS_LOG_UNCOND("int update");
-            IntegerUpdate (m, rttShift, variationShift);
-          }
-        else
-          {
-            //NS_LOG_UNCOND("float update");
-            FloatingPointUpdatePeakHopper(m);
-          }
     }
   else
     { // First sample
@@ -314,9 +396,73 @@ RttMeanDeviation::Measurement (Time m)
       NS_LOG_DEBUG ("(first sample) m_estimatedVariation += " << m);
     }
   m_nSamples++;
-  pr = m;
 }
 
+void
+RttMeanDeviation::MeasurementBatch (const std::vector<Time> &samples)
+{
+  NS_LOG_FUNCTION (this << samples.size ());
+  std::vector<Time>::const_iterator it = samples.begin ();
+  if (it == samples.end ())
+    {
+      return;
+    }
+  if (m_nSamples == 0)
+    {
+      Measurement (*it++);
+    }
+
+  uint32_t rttShift = 0;
+  uint32_t variationShift = 0;
+  int64_t gain = 0;
+  if (m_peakHopper)
+    {
+      if (!m_integerPeakHopper)
+        {
+          for (; it != samples.end (); ++it)
+            {
+              Measurement (*it);
+            }
+          return;
+        }
+      gain = static_cast<int64_t> (m_gain * (1 << GAIN_SHIFT) + 0.5);
+    }
+  else
+    {
+      rttShift = CheckForReciprocalPowerOfTwo (m_alpha);
+      variationShift = CheckForReciprocalPowerOfTwo (m_beta);
+      if (!rttShift || !variationShift)
+        {
+          for (; it != samples.end (); ++it)
+            {
+              Measurement (*it);
+            }
+          return;
+        }
+    }
+
+  int64_t srtt = m_estimatedRtt.GetInteger ();
+  int64_t rttvar = m_estimatedVariation.GetInteger ();
+  uint32_t n = 0;
+  if (m_peakHopper)
+    {
+      int64_t gainSquared = (gain * gain) >> GAIN_SHIFT;
+      for (; it != samples.end (); ++it, ++n)
+        {
+          PeakHopperStep (it->GetInteger (), srtt, rttvar, gain, gainSquared);
+        }
+    }
+  else
+    {
+      for (; it != samples.end (); ++it, ++n)
+        {
+          JacobsonStep (it->GetInteger (), srtt, rttvar, rttShift, variationShift);
+        }
+    }
+  m_estimatedRtt = Time::From (srtt);
+  m_estimatedVariation = Time::From (rttvar);
+  m_nSamples += n;
+}
 
 /*
 void 
@@ -369,4 +515,197 @@ RttMeanDeviation::Reset ()
   RttEstimator::Reset ();
 }
 
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+// Quantile Estimator
+
+NS_OBJECT_ENSURE_REGISTERED (RttQuantile);
+
+TypeId
+RttQuantile::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::RttQuantile")
+    .SetParent<RttEstimator> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<RttQuantile> ()
+    .AddAttribute ("Quantile",
+                   "Quantile of the RTT samples used as RTO basis, must be 0 < quantile < 1",
+                   DoubleValue (0.99),
+                   MakeDoubleAccessor (&RttQuantile::m_quantile),
+                   MakeDoubleChecker<double> (0.01, 0.999))
+    .AddAttribute ("Window",
+                   "Number of samples after which older samples weigh half (0: never)",
+                   UintegerValue (1000),
+                   MakeUintegerAccessor (&RttQuantile::m_window),
+                   MakeUintegerChecker<uint32_t> ())
+  ;
+  return tid;
+}
+
+RttQuantile::RttQuantile ()
+{
+  NS_LOG_FUNCTION (this);
+  std::fill (m_height, m_height + 5, 0.0);
+  std::fill (m_position, m_position + 5, 0.0);
+  std::fill (m_desired, m_desired + 5, 0.0);
+}
+
+RttQuantile::RttQuantile (const RttQuantile& c)
+  : RttEstimator (c), m_quantile (c.m_quantile), m_window (c.m_window)
+{
+  NS_LOG_FUNCTION (this);
+  std::copy (c.m_height, c.m_height + 5, m_height);
+  std::copy (c.m_position, c.m_position + 5, m_position);
+  std::copy (c.m_desired, c.m_desired + 5, m_desired);
+}
+
+TypeId
+RttQuantile::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+RttQuantile::AdjustMarker (uint32_t i, double d)
+{
+  const double *n = m_position;
+  double *q = m_height;
+  // Piecewise-parabolic prediction
+  double qp = q[i] + d / (n[i + 1] - n[i - 1])
+    * ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i])
+       + (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+  if (q[i - 1] < qp && qp < q[i + 1])
+    {
+      q[i] = qp;
+    }
+  else
+    {
+      uint32_t j = d > 0 ? i + 1 : i - 1;
+      q[i] += d * (q[j] - q[i]) / (n[j] - n[i]);
+    }
+  m_position[i] += d;
+}
+
+void
+RttQuantile::UpdateEstimate (void)
+{
+  m_estimatedRtt = Time::From (static_cast<int64_t> (m_height[1]));
+  m_estimatedVariation = Time::From (static_cast<int64_t> ((m_height[2] - m_height[1]) / 4));
+}
+
+void
+RttQuantile::Measurement (Time m)
+{
+  NS_LOG_FUNCTION (this << m);
+  double x = static_cast<double> (m.GetInteger ());
+  if (m_nSamples < 5)
+    {
+      // Keep the first samples sorted, they become the markers
+      uint32_t k = m_nSamples;
+      while (k > 0 && m_height[k - 1] > x)
+        {
+          m_height[k] = m_height[k - 1];
+          --k;
+        }
+      m_height[k] = x;
+      m_nSamples++;
+      if (m_nSamples < 5)
+        {
+          // Not enough samples for a quantile, be as cautious as RFC 6298
+          m_estimatedRtt = Time::From (static_cast<int64_t> (m_height[m_nSamples / 2]));
+          m_estimatedVariation = m_estimatedRtt / 2;
+          return;
+        }
+      const double p = m_quantile;
+      const double desired[5] = { 0, 2 * p, 4 * p, 2 + 2 * p, 4 };
+      for (uint32_t i = 0; i < 5; ++i)
+        {
+          m_position[i] = i;
+          m_desired[i] = desired[i];
+        }
+      UpdateEstimate ();
+      return;
+    }
+
+  // Cell of the new sample, stretching the extreme markers if needed
+  uint32_t k;
+  if (x < m_height[0])
+    {
+      m_height[0] = x;
+      k = 0;
+    }
+  else if (x >= m_height[4])
+    {
+      m_height[4] = x;
+      k = 3;
+    }
+  else
+    {
+      k = 0;
+      while (x >= m_height[k + 1])
+        {
+          ++k;
+        }
+    }
+
+  const double p = m_quantile;
+  const double increment[5] = { 0, p / 2, p, (1 + p) / 2, 1 };
+  for (uint32_t i = 0; i < 5; ++i)
+    {
+      if (i > k)
+        {
+          m_position[i] += 1;
+        }
+      m_desired[i] += increment[i];
+    }
+
+  for (uint32_t i = 1; i < 4; ++i)
+    {
+      double d = m_desired[i] - m_position[i];
+      if ((d >= 1 && m_position[i + 1] - m_position[i] > 1)
+          || (d <= -1 && m_position[i - 1] - m_position[i] < -1))
+        {
+          AdjustMarker (i, d > 0 ? 1.0 : -1.0);
+        }
+    }
+
+  if (m_window > 0 && m_position[4] >= 2.0 * m_window)
+    {
+      // Halve the weight of the samples seen so far
+      for (uint32_t i = 0; i < 5; ++i)
+        {
+          m_position[i] /= 2;
+          m_desired[i] /= 2;
+        }
+    }
+
+  UpdateEstimate ();
+  m_nSamples++;
+}
+
+Ptr<RttEstimator>
+RttQuantile::Copy () const
+{
+  NS_LOG_FUNCTION (this);
+  return CopyObject<RttQuantile> (this);
+}
+
+void
+RttQuantile::Reset ()
+{
+  NS_LOG_FUNCTION (this);
+  RttEstimator::Reset ();
+}
+
+void
+RttQuantile::Seed (Time estimate, Time variation)
+{
+  NS_LOG_FUNCTION (this << estimate << variation);
+  if (m_nSamples == 0)
+    {
+      m_estimatedRtt = estimate;
+      m_estimatedVariation = variation;
+    }
+}
+
 } //namespace ns3
@@ -25,6 +25,8 @@
 #ifndef RTT_ESTIMATOR_H
 #define RTT_ESTIMATOR_H
 
+#include <vector>
+
 #include "ns3/nstime.h"
 #include "ns3/object.h"
 
@@ -65,6 +67,15 @@ public:
    */
   virtual void  Measurement (Time t) = 0;
 
+  /**
+   * \brief Add several measurements to the estimator, in order.
+   *
+   * The default implementation calls Measurement () for each sample.
+   *
+   * \param samples the new RTT measures, oldest first.
+   */
+  virtual void  MeasurementBatch (const std::vector<Time> &samples);
+
   /**
    * \brief Copy object (including current internal state)
    * \returns a copy of itself
@@ -76,6 +87,17 @@ public:
    */
   virtual void Reset ();
 
+  /**
+   * \brief Start from an estimate carried over from earlier connections
+   *
+   * The seed counts as one sample, so the next measurement is filtered on
+   * top of it instead of replacing it.
+   *
+   * \param estimate the RTT estimate
+   * \param variation its variation
+   */
+  virtual void Seed (Time estimate, Time variation);
+
   /**
    * \brief gets the RTT estimate.
    * \return The RTT estimate.
@@ -144,6 +166,16 @@ public:
    */
   void Measurement (Time measure);
 
+  /**
+   * \brief Add several measurements to the estimator, in order.
+   *
+   * When the integer update applies, the whole batch is filtered on raw
+   * ticks held in locals and the estimate is stored once at the end.
+   *
+   * \param samples the new RTT measures, oldest first.
+   */
+  void MeasurementBatch (const std::vector<Time> &samples);
+
   Ptr<RttEstimator> Copy () const;
 
   /**
@@ -185,10 +217,104 @@ private:
   //---------------------added by afnan---------------------
   void FloatingPointUpdatePeakHopper (Time m);
   //---------------------------------------------------------
+  /**
+   * Method to update the rtt and variation estimates with the PeakHopper
+   * filter using integer arithmetic on the raw Time ticks. The gain is
+   * converted to Q16 fixed point; squaring it for negative deviations
+   * is done in the same format.
+   *
+   * \param m time measurement
+   */
+  void IntegerUpdatePeakHopper (Time m);
   double       m_alpha;       //!< Filter gain for average
   double       m_beta;        //!< Filter gain for variation
   bool         m_peakHopper;
+  bool         m_integerPeakHopper; //!< Use IntegerUpdatePeakHopper
+
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief RTT estimator that tracks a high quantile of the samples
+ *
+ * The estimator keeps the five markers of the P-square algorithm (Jain and
+ * Chlamtac, "The P2 algorithm for dynamic calculation of quantiles and
+ * histograms without storing observations", CACM 1985) for the quantile p
+ * given by the Quantile attribute. The markers sit at the minimum, p/2, p,
+ * (1+p)/2 and the maximum of the samples; each measurement moves at most
+ * the three middle ones by one position, in constant time and without
+ * allocating.
+ *
+ * The estimate is the p/2 marker (close to the median for high quantiles)
+ * and the variation is a quarter of the distance from it to the p marker,
+ * so that estimate + 4 * variation, as used by TcpRtoRfc6298 and
+ * TcpRtoLinux, is the p-quantile of the RTT.
+ *
+ * Every Window samples, the marker positions are halved, so that older
+ * samples weigh half as much as the recent ones.
+ */
+class RttQuantile : public RttEstimator {
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  RttQuantile ();
+
+  /**
+   * \brief Copy constructor
+   * \param r the object to copy
+   */
+  RttQuantile (const RttQuantile& r);
+
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  /**
+   * \brief Add a new measurement to the estimator.
+   * \param measure the new RTT measure.
+   */
+  void Measurement (Time measure);
+
+  Ptr<RttEstimator> Copy () const;
+
+  /**
+   * \brief Resets the estimator.
+   */
+  void Reset ();
+
+  /**
+   * \brief Start from an estimate carried over from earlier connections
+   *
+   * The markers need real samples: the seed only holds until the first
+   * one, which replaces it.
+   *
+   * \param estimate the RTT estimate
+   * \param variation its variation
+   */
+  void Seed (Time estimate, Time variation);
+
+private:
+  /**
+   * Move marker i by one position towards its desired position, on the
+   * parabola through its neighbours, or linearly if that would break the
+   * order of the markers.
+   *
+   * \param i the marker, 1 to 3
+   * \param d +1 or -1
+   */
+  void AdjustMarker (uint32_t i, double d);
+
+  /// Publish the markers as estimate and variation
+  void UpdateEstimate (void);
 
+  double       m_quantile;      //!< Tracked quantile p
+  uint32_t     m_window;        //!< Samples after which positions are halved
+  double       m_height[5];     //!< Marker heights, in Time ticks
+  double       m_position[5];   //!< Marker positions, 0-based
+  double       m_desired[5];    //!< Desired marker positions
 };
 
 } // namespace ns3
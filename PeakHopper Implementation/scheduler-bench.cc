@@ -0,0 +1,153 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Benchmark of the event schedulers under the timer churn of the
+// simulate.cc dumbbell.
+//
+// Each flow is reduced to its timers. ACKs arrive every RTT / cwnd, and
+// every ACK cancels the retransmission timeout of the sender and re-arms it
+// an RTO later, as TcpSocketBase::NewAck does. The receiver re-arms its
+// delayed ACK timer on every other segment. Half of the flows use the 85 ms
+// access links and half the 175 ms ones, behind the 50 ms bottleneck. The
+// RTO and delayed ACK timeouts almost never fire, so the schedulers mostly
+// sort and drop cancelled events, as in the real runs.
+//
+// The same workload runs once per scheduler, and the wall time of
+// Simulator::Run () is reported:
+//
+//   ./waf --run "scratch/scheduler-bench --flows=200 --duration=50"
+//
+// To time the full dumbbell instead, pass --scheduler to simulate.cc.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+
+#include "ladder-scheduler.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("SchedulerBench");
+
+/**
+ * Timers of one flow
+ */
+struct BenchFlow
+{
+  Time ackInterval;     //!< RTT / cwnd
+  Time rto;             //!< Retransmission timeout
+  EventId retx;         //!< Sender retransmission timer
+  EventId delAck;       //!< Receiver delayed ACK timer
+  uint32_t segments;    //!< Segments received
+};
+
+static std::vector<BenchFlow> g_flows;
+static uint64_t g_acks = 0;
+static uint64_t g_timeouts = 0;
+
+static void
+Timeout (void)
+{
+  ++g_timeouts;
+}
+
+static void
+Ack (uint32_t i)
+{
+  BenchFlow &f = g_flows[i];
+  ++g_acks;
+  f.retx.Cancel ();
+  f.retx = Simulator::Schedule (f.rto, &Timeout);
+  if (++f.segments % 2 == 1)
+    {
+      f.delAck.Cancel ();
+      f.delAck = Simulator::Schedule (MilliSeconds (200), &Timeout);
+    }
+  Simulator::Schedule (f.ackInterval, &Ack, i);
+}
+
+static void
+RunScheduler (const std::string &scheduler, uint32_t nFlows, uint32_t cwnd, double duration)
+{
+  ObjectFactory factory;
+  factory.SetTypeId (scheduler);
+  Simulator::SetScheduler (factory);
+
+  g_flows.assign (nFlows, BenchFlow ());
+  g_acks = 0;
+  g_timeouts = 0;
+  for (uint32_t i = 0; i < nFlows; ++i)
+    {
+      // 2 * (access + bottleneck + access), as in simulate.cc
+      Time rtt = MilliSeconds (i % 2 == 0 ? 2 * (175 + 50 + 175) : 2 * (85 + 50 + 85));
+      g_flows[i].ackInterval = rtt / cwnd;
+      g_flows[i].rto = rtt + MilliSeconds (200);
+      g_flows[i].segments = 0;
+      Simulator::Schedule (MilliSeconds (100) * i / nFlows, &Ack, i);
+    }
+
+  Simulator::Stop (Seconds (duration));
+  auto start = std::chrono::steady_clock::now ();
+  Simulator::Run ();
+  auto stop = std::chrono::steady_clock::now ();
+  Simulator::Destroy ();
+
+  double seconds = std::chrono::duration<double> (stop - start).count ();
+  std::cout << std::left << std::setw (28) << scheduler
+            << std::right << std::fixed
+            << std::setw (12) << g_acks
+            << std::setw (10) << g_timeouts
+            << std::setw (10) << std::setprecision (3) << seconds
+            << std::setw (10) << std::setprecision (1) << seconds * 1e9 / g_acks
+            << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nFlows = 200;
+  uint32_t cwnd = 40;
+  double duration = 50;
+  std::string schedulers = "ns3::MapScheduler,ns3::HeapScheduler,ns3::CalendarScheduler,ns3::PriorityQueueScheduler,ns3::LadderScheduler";
+
+  CommandLine cmd;
+  cmd.AddValue ("flows", "Number of flows", nFlows);
+  cmd.AddValue ("cwnd", "Segments per RTT of each flow", cwnd);
+  cmd.AddValue ("duration", "Simulated time in seconds", duration);
+  cmd.AddValue ("schedulers", "Comma-separated scheduler TypeIds", schedulers);
+  cmd.Parse (argc, argv);
+
+  std::cout << std::left << std::setw (28) << "scheduler"
+            << std::right
+            << std::setw (12) << "acks"
+            << std::setw (10) << "timeouts"
+            << std::setw (10) << "wall s"
+            << std::setw (10) << "ns/ack" << std::endl;
+  std::istringstream in (schedulers);
+  std::string scheduler;
+  while (std::getline (in, scheduler, ','))
+    {
+      RunScheduler (scheduler, nFlows, cwnd, duration);
+    }
+
+  return 0;
+}
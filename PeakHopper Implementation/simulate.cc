@@ -37,8 +37,11 @@
  */
 
 #include <iostream>
+#include <cmath>
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -54,54 +57,56 @@
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/traffic-control-module.h"
 
+#include "binary-trace.h"
+#include "ladder-scheduler.h"
+#include "split-simulation.h"
+#include "flow-sampler.h"
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("TcpVariantsComparison");
 
-static bool firstCwnd = true;
-static bool firstSshThr = true;
-static bool firstRtt = true;
-static bool firstRto = true;
-static bool firstRto_by_rtt = true;
-static bool firstMean_retransmission = true;
-
-static Ptr<OutputStreamWrapper> cWndStream;
-static Ptr<OutputStreamWrapper> ssThreshStream;
-static Ptr<OutputStreamWrapper> rttStream;
-static Ptr<OutputStreamWrapper> rtoStream;
+// Per flow, whether the tracer has not seen an event yet; the first event
+// also records the initial value at time 0
+struct FirstEvent
+{
+  bool cwnd {true};
+  bool sshThr {true};
+  bool rtt {true};
+  bool rto {true};
+  bool rto_by_rtt {true};
+  bool mean_retransmission {true};
+};
+static std::vector<FirstEvent> firstEvent;
+
+static BinaryTraceWriter *traceWriter = nullptr;
 static Ptr<OutputStreamWrapper> nextTxStream;
 static Ptr<OutputStreamWrapper> nextRxStream;
 static Ptr<OutputStreamWrapper> inFlightStream;
-static Ptr<OutputStreamWrapper> rto_by_rttStream;
-static Ptr<OutputStreamWrapper> mean_retransmissionStream;
+// Rows of rto-stats.csv, written by the sockets as they close
+static std::ostringstream rtoStatsRows;
 
 
 static void
-CwndTracer (uint32_t oldval, uint32_t newval)
+CwndTracer (uint32_t flow, uint32_t oldval, uint32_t newval)
 {
-  if (firstCwnd)
-    {
-      *cWndStream->GetStream () << "0.0 " << oldval << std::endl;
-      firstCwnd = false;
-    }
-  else
+  if (firstEvent[flow].cwnd)
     {
-      *ssThreshStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval<< std::endl;
+      traceWriter->Append (Time (0), flow, TRACE_CWND, oldval);
+      firstEvent[flow].cwnd = false;
     }
+  traceWriter->Append (Simulator::Now (), flow, TRACE_CWND, newval);
 }
 
 static void
-SsThreshTracer (uint32_t oldval, uint32_t newval)
+SsThreshTracer (uint32_t flow, uint32_t oldval, uint32_t newval)
 {
-  if (firstSshThr)
+  if (firstEvent[flow].sshThr)
     {
-      *ssThreshStream->GetStream () << "0.0 " << oldval << std::endl;
-      firstSshThr = false;
-    }
-  else
-    {
-      *cWndStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval << std::endl;
+      traceWriter->Append (Time (0), flow, TRACE_SSTHRESH, oldval);
+      firstEvent[flow].sshThr = false;
     }
+  traceWriter->Append (Simulator::Now (), flow, TRACE_SSTHRESH, newval);
 }
 
 //-----------------------added by afnan---------------------------
@@ -116,52 +121,52 @@ Ptr<OutputStreamWrapper> result = asciiTraceHelper.CreateFileStream ("metrics.da
 
 
 static void
-RttTracer (Time oldval, Time newval)
+RttTracer (uint32_t flow, Time oldval, Time newval)
 {
-  if (firstRtt)
+  if (firstEvent[flow].rtt)
     {
-      *rttStream->GetStream () << "0.0 " << oldval.GetSeconds () << std::endl;
-      firstRtt = false;
+      traceWriter->Append (Time (0), flow, TRACE_RTT, oldval.GetSeconds ());
+      firstEvent[flow].rtt = false;
     }
-  *rttStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval.GetSeconds () << std::endl;
+  traceWriter->Append (Simulator::Now (), flow, TRACE_RTT, newval.GetSeconds ());
 }
 
 static void
-RtoTracer (Time oldval, Time newval)
+RtoTracer (uint32_t flow, Time oldval, Time newval)
 {
-  if (firstRto)
+  if (firstEvent[flow].rto)
     {
-      *rtoStream->GetStream () << "0.0 " << oldval.GetSeconds () << std::endl;
-      firstRto = false;
+      traceWriter->Append (Time (0), flow, TRACE_RTO, oldval.GetSeconds ());
+      firstEvent[flow].rto = false;
     }
   else{
-    *rtoStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval.GetSeconds () << std::endl;
+    traceWriter->Append (Simulator::Now (), flow, TRACE_RTO, newval.GetSeconds ());
   }
 }
 
 static void 
-RtoByRttTracer (double oldval, double newval)
+RtoByRttTracer (uint32_t flow, double oldval, double newval)
 {
-  if (firstRto_by_rtt)
+  if (firstEvent[flow].rto_by_rtt)
     {
-      *rto_by_rttStream->GetStream () << "0.0 " << oldval << std::endl;
-      firstRto_by_rtt = false;
+      traceWriter->Append (Time (0), flow, TRACE_RTO_BY_RTT, oldval);
+      firstEvent[flow].rto_by_rtt = false;
     }
   else{
-    *rto_by_rttStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval << std::endl;
+    traceWriter->Append (Simulator::Now (), flow, TRACE_RTO_BY_RTT, newval);
   }
 }
 
 static void 
-MeanRetransmissionTracer (double oldval, double newval)
+MeanRetransmissionTracer (uint32_t flow, double oldval, double newval)
 {
-  if (firstMean_retransmission)
+  if (firstEvent[flow].mean_retransmission)
     {
-      *mean_retransmissionStream->GetStream () << "0.0 " << oldval << std::endl;
-      firstMean_retransmission = false;
+      traceWriter->Append (Time (0), flow, TRACE_MEAN_RETRANSMISSION, oldval);
+      firstEvent[flow].mean_retransmission = false;
     }
   else{
-    *mean_retransmissionStream->GetStream () << Simulator::Now ().GetSeconds () << " " << newval << std::endl;
+    traceWriter->Append (Simulator::Now (), flow, TRACE_MEAN_RETRANSMISSION, newval);
   }
 }
 
@@ -187,20 +192,24 @@ NextRxTracer (SequenceNumber32 old, SequenceNumber32 nextRx)
   *nextRxStream->GetStream () << Simulator::Now ().GetSeconds () << " " << nextRx << std::endl;
 }
 */
+// Sender socket of a flow: sources follow the two gateways in the NodeList,
+// and their BulkSendApplication opens a single socket
+static std::string
+FlowSocketPath (uint32_t flow)
+{
+  return "/NodeList/" + std::to_string (2 + flow) + "/$ns3::TcpL4Protocol/SocketList/0/";
+}
+
 static void
-TraceCwnd (std::string cwnd_tr_file_name)
+TraceCwnd (uint32_t flow)
 {
-  AsciiTraceHelper ascii;
-  cWndStream = ascii.CreateFileStream (cwnd_tr_file_name.c_str ());
-  Config::ConnectWithoutContext ("/NodeList/2/$ns3::TcpL4Protocol/SocketList/0/CongestionWindow", MakeCallback (&CwndTracer));
+  Config::ConnectWithoutContext (FlowSocketPath (flow) + "CongestionWindow", MakeBoundCallback (&CwndTracer, flow));
 }
 
 static void
-TraceSsThresh (std::string ssthresh_tr_file_name)
+TraceSsThresh (uint32_t flow)
 {
-  AsciiTraceHelper ascii;
-  ssThreshStream = ascii.CreateFileStream (ssthresh_tr_file_name.c_str ());
-  Config::ConnectWithoutContext ("/NodeList/2/$ns3::TcpL4Protocol/SocketList/0/SlowStartThreshold", MakeCallback (&SsThreshTracer));
+  Config::ConnectWithoutContext (FlowSocketPath (flow) + "SlowStartThreshold", MakeBoundCallback (&SsThreshTracer, flow));
 }
 /*
 static void
@@ -232,36 +241,51 @@ RxTracer(const Ptr< const Packet > packet, const TcpHeader &header, const Ptr< c
 }
 */
 static void
-TraceRtt (std::string rtt_tr_file_name)
+TraceRtt (uint32_t flow)
 {
-  AsciiTraceHelper ascii;
-  rttStream = ascii.CreateFileStream (rtt_tr_file_name.c_str ());
-  Config::ConnectWithoutContext ("/NodeList/2/$ns3::TcpL4Protocol/SocketList/0/RTT", MakeCallback (&RttTracer));
+  Config::ConnectWithoutContext (FlowSocketPath (flow) + "RTT", MakeBoundCallback (&RttTracer, flow));
 }
 
 static void
-TraceRto (std::string rto_tr_file_name)
+TraceRto (uint32_t flow)
 {
-  AsciiTraceHelper ascii;
-  rtoStream = ascii.CreateFileStream (rto_tr_file_name.c_str ());
-  Config::ConnectWithoutContext ("/NodeList/2/$ns3::TcpL4Protocol/SocketList/0/RTO", MakeCallback (&RtoTracer));
+  Config::ConnectWithoutContext (FlowSocketPath (flow) + "RTO", MakeBoundCallback (&RtoTracer, flow));
 }
 
 static void
-TraceRto_By_Rtt (std::string rto_tr_file_name)
+TraceRto_By_Rtt (uint32_t flow)
 {
-  AsciiTraceHelper ascii;
-  rto_by_rttStream = ascii.CreateFileStream (rto_tr_file_name.c_str ());
-  Config::ConnectWithoutContext ("/NodeList/2/$ns3::TcpL4Protocol/SocketList/0/rto_by_rttTrace", MakeCallback (&RtoByRttTracer));
+  Config::ConnectWithoutContext (FlowSocketPath (flow) + "rto_by_rttTrace", MakeBoundCallback (&RtoByRttTracer, flow));
 }
 
 
 static void
-TraceMeanRetransmission (std::string rto_tr_file_name)
+TraceMeanRetransmission (uint32_t flow)
 {
-  AsciiTraceHelper ascii;
-  mean_retransmissionStream = ascii.CreateFileStream (rto_tr_file_name.c_str ());
-  Config::ConnectWithoutContext ("/NodeList/2/$ns3::TcpL4Protocol/SocketList/0/m_mean_retransmisionTrace", MakeCallback (&MeanRetransmissionTracer));
+  Config::ConnectWithoutContext (FlowSocketPath (flow) + "m_mean_retransmisionTrace", MakeBoundCallback (&MeanRetransmissionTracer, flow));
+}
+
+static void
+RtoStatsTracer (uint32_t flow, const RtoStats &stats)
+{
+  stats.Write (rtoStatsRows, flow);
+}
+
+static void
+TraceRtoStats (uint32_t flow)
+{
+  Config::ConnectWithoutContext (FlowSocketPath (flow) + "RtoStats", MakeBoundCallback (&RtoStatsTracer, flow));
+}
+
+static void
+TraceFlow (uint32_t flow)
+{
+  TraceCwnd (flow);
+  TraceSsThresh (flow);
+  TraceRtt (flow);
+  TraceRto (flow);
+  TraceRto_By_Rtt (flow);
+  TraceMeanRetransmission (flow);
 }
 
 
@@ -310,6 +334,8 @@ int main (int argc, char *argv[])
   std::string access_delay = "45ms";
   */
   bool tracing = true;
+  bool trace_text = true;
+  bool trace_all_flows = false;
   bool justa = false;
   bool peakHopper = false;
   std::string prefix_file_name = "";
@@ -317,8 +343,11 @@ int main (int argc, char *argv[])
   uint32_t mtu_bytes = 400;
   uint16_t num_flows = 6;
   double duration = 20.0;
-  uint32_t run = 0;
+  uint32_t run = SeedManager::GetRun (); // RngRun, unless --run is given
   bool flow_monitor = true;
+  double sample_window = 0;
+  bool split = false;
+  uint32_t processes = 1;
   bool pcap = false;
   bool sack = false;
   //-----------------------added by afnan----------------------
@@ -338,6 +367,15 @@ int main (int argc, char *argv[])
 
   std::string queue_disc_type = "ns3::PfifoFastQueueDisc";
   std::string recovery = "ns3::TcpClassicRecovery";
+  std::string rto_type = "ns3::TcpRtoRfc6298";
+  std::string rtt_type = "ns3::RttMeanDeviation";
+  std::string scheduler = "ns3::MapScheduler";
+  bool lazy_retx_timer = false;
+  bool undo_spurious_rto = false;
+  bool rack_tlp = false;
+  bool metrics_cache = false;
+  bool metrics_share_live = false;
+  bool rto_stats = false;
 
 
   CommandLine cmd;
@@ -351,27 +389,68 @@ int main (int argc, char *argv[])
   cmd.AddValue ("access_bandwidth", "Access link bandwidth", access_bandwidth);
   cmd.AddValue ("access_delay", "Access link delay", access_delay);
   cmd.AddValue ("tracing", "Flag to enable/disable tracing", tracing);
+  cmd.AddValue ("trace_all_flows", "Trace every flow instead of the first one only", trace_all_flows);
+  cmd.AddValue ("trace_text", "Convert the binary trace to .data files at the end of the run", trace_text);
   cmd.AddValue ("justa", "Rto calculation algorithm type to use ", justa);
   cmd.AddValue ("prefix_name", "Prefix of output trace file", prefix_file_name);
   cmd.AddValue ("data", "Number of Megabytes of data to transmit", data_mbytes);
   cmd.AddValue ("mtu", "Size of IP packets to send in bytes", mtu_bytes);
   cmd.AddValue ("num_flows", "Number of flows", num_flows);
   cmd.AddValue ("duration", "Time to allow flows to run in seconds", duration);
-  cmd.AddValue ("run", "Run index (for setting repeatable seeds)", run);
+  cmd.AddValue ("run", "Run index (for setting repeatable seeds), RngRun by default", run);
   cmd.AddValue ("flow_monitor", "Enable flow monitor", flow_monitor);
+  cmd.AddValue ("split", "Run the left and right halves of the dumbbell in two processes", split);
+  cmd.AddValue ("processes", "Run the gateways and groups of flows in this many processes (3 or more)", processes);
+  cmd.AddValue ("sample_window", "Write per-flow statistics every sample_window seconds to windows.csv, needs flow_monitor (0: off)", sample_window);
   cmd.AddValue ("pcap_tracing", "Enable or disable PCAP tracing", pcap);
   cmd.AddValue ("queue_disc_type", "Queue disc type for gateway (e.g. ns3::CoDelQueueDisc)", queue_disc_type);
   cmd.AddValue ("sack", "Enable or disable SACK option", sack);
   cmd.AddValue ("recovery", "Recovery algorithm type to use (e.g., ns3::TcpPrrRecovery", recovery);
   cmd.AddValue ("peakHopper", "Rto calculation algorithm type to use ", peakHopper);
-
+  cmd.AddValue ("rto_type", "Rto calculation algorithm type to use (e.g., ns3::TcpRtoLinux, ns3::TcpRtoEifel)", rto_type);
+  cmd.AddValue ("rtt_type", "RTT estimator type to use (e.g., ns3::RttQuantile)", rtt_type);
+
+  cmd.AddValue ("lazy_retx_timer", "Move the retransmission deadline on new ACKs instead of rescheduling the timer", lazy_retx_timer);
+  cmd.AddValue ("undo_spurious_rto", "Detect spurious RTOs (Eifel, F-RTO, D-SACK) and undo their window reduction", undo_spurious_rto);
+  cmd.AddValue ("rack_tlp", "Detect losses from segment send times (RACK) and probe tail losses (TLP), needs SACK", rack_tlp);
+  cmd.AddValue ("metrics_cache", "Seed new connections from a per-destination RTT cache on every node", metrics_cache);
+  cmd.AddValue ("metrics_share_live", "Share the RTT of running connections through the cache", metrics_share_live);
+  cmd.AddValue ("rto_stats", "Write per-flow RTO/RTT, stall and backoff histograms to rto-stats.csv", rto_stats);
+  cmd.AddValue ("scheduler", "Event scheduler (e.g. ns3::LadderScheduler, ns3::CalendarScheduler)", scheduler);
   cmd.Parse (argc, argv);
 
+  ObjectFactory schedulerFactory;
+  schedulerFactory.SetTypeId (scheduler);
+  Simulator::SetScheduler (schedulerFactory);
+
   transport_prot = std::string ("ns3::") + transport_prot;
 
   SeedManager::SetSeed (1);
   SeedManager::SetRun (run);
 
+  // Every process builds the whole topology. With two processes the first
+  // one runs the sources and the left gateway, the second one the sinks and
+  // the right gateway. With more, the first one runs both gateways and the
+  // others a share of the flows each. Only the process of the source of
+  // flow 0 writes traces.
+  SplitSimulation *splitSimulation = nullptr;
+  if (split)
+    {
+      processes = 2;
+    }
+  if (processes > 1)
+    {
+      NS_ABORT_MSG_IF (sample_window > 0, "--sample_window is not supported with several processes");
+      NS_ABORT_MSG_IF (processes > 2 && trace_all_flows, "--trace_all_flows is not supported with more than 2 processes");
+      splitSimulation = new SplitSimulation (processes);
+      uint32_t rank = splitSimulation->Fork ();
+      if (rank != (processes == 2 ? 0 : 1))
+        {
+          tracing = false;
+          pcap = false;
+        }
+    }
+
   // User may find it convenient to enable logging
   //LogComponentEnable("TcpVariantsComparison", LOG_LEVEL_ALL);
   //LogComponentEnable("BulkSendApplication", LOG_LEVEL_INFO);
@@ -397,6 +476,15 @@ int main (int argc, char *argv[])
   Config::SetDefault ("ns3::TcpSocket::RcvBufSize", UintegerValue (1 << 21));
   Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (1 << 21));
   Config::SetDefault ("ns3::TcpSocketBase::Sack", BooleanValue (sack));
+  Config::SetDefault ("ns3::TcpSocketBase::LazyRetxTimer", BooleanValue (lazy_retx_timer));
+  Config::SetDefault ("ns3::TcpSocketBase::SpuriousRtoDetection", BooleanValue (undo_spurious_rto));
+  Config::SetDefault ("ns3::TcpSocketBase::RackTlp", BooleanValue (rack_tlp));
+  Config::SetDefault ("ns3::TcpMetricsCache::ShareLive", BooleanValue (metrics_share_live));
+
+  Config::SetDefault ("ns3::TcpSocketBase::RtoType",
+                      TypeIdValue (TypeId::LookupByName (rto_type)));
+  Config::SetDefault ("ns3::TcpL4Protocol::RttEstimatorType",
+                      TypeIdValue (TypeId::LookupByName (rtt_type)));
 
   if(peakHopper){
     Config::SetDefault("ns3::TcpSocketBase::m_peakHopper", BooleanValue(peakHopper));
@@ -464,6 +552,13 @@ int main (int argc, char *argv[])
   NS_LOG_INFO ("Install internet stack on all nodes.");
   InternetStackHelper stack;
   stack.InstallAll ();
+  if (metrics_cache)
+    {
+      for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); ++i)
+        {
+          (*i)->AggregateObject (CreateObject<TcpMetricsCache> ());
+        }
+    }
 
   NetDeviceContainer gates;
   gates = BottleNeckLink.Install (leftGate.Get (0),rightGate.Get (0));
@@ -516,6 +611,18 @@ int main (int argc, char *argv[])
         }
       }
 
+  if (splitSimulation != nullptr)
+    {
+      uint32_t n = splitSimulation->GetNProcesses ();
+      for (int i = 0; i < num_flows; i++)
+        {
+          splitSimulation->SetOwner (sources.Get (i), n == 2 ? 0 : 1 + i % (n - 1));
+          splitSimulation->SetOwner (sinks.Get (i), n == 2 ? 1 : 1 + i % (n - 1));
+        }
+      splitSimulation->SetOwner (rightGate.Get (0), n == 2 ? 1 : 0);
+      splitSimulation->Install ();
+    }
+
   NS_LOG_INFO ("Initialize Global Routing.");
   Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
@@ -535,11 +642,19 @@ int main (int argc, char *argv[])
       ApplicationContainer sourceApp = ftp.Install (sources.Get (i));
       sourceApp.Start (Seconds (start_time * i));
       sourceApp.Stop (Seconds (stop_time - 3));
+      if (splitSimulation != nullptr && !splitSimulation->IsLocal (sources.Get (i)))
+        {
+          sourceApp.Start (Seconds (stop_time + 1));
+        }
 
       sinkHelper.SetAttribute ("Protocol", TypeIdValue (TcpSocketFactory::GetTypeId ()));
       ApplicationContainer sinkApp = sinkHelper.Install (sinks.Get (i));
       sinkApp.Start (Seconds (start_time * i));
       sinkApp.Stop (Seconds (stop_time));
+      if (splitSimulation != nullptr && !splitSimulation->IsLocal (sinks.Get (i)))
+        {
+          sinkApp.Start (Seconds (stop_time + 1));
+        }
     }
 
   // Set up tracing if enabled
@@ -552,12 +667,17 @@ int main (int argc, char *argv[])
                                             std::ios::out);
       stack.EnableAsciiIpv4All (ascii_wrap);
 
-      Simulator::Schedule (Seconds (0.1), &TraceCwnd, prefix_file_name + "cwnd.data");
-      Simulator::Schedule (Seconds (0.1), &TraceSsThresh, prefix_file_name + "ssth.data");
-      Simulator::Schedule (Seconds (0.1), &TraceRtt, prefix_file_name + "rtt.data");   //3rd arg ta TraceRtt func er parameter
-      Simulator::Schedule (Seconds (0.1), &TraceRto, prefix_file_name + "rto.data");
-      Simulator::Schedule (Seconds (0.1), &TraceRto_By_Rtt, prefix_file_name + "rto_by_rtt.data");
-      Simulator::Schedule (Seconds (0.1), &TraceMeanRetransmission, prefix_file_name + "mean_retransmission.data");
+      // cwnd, ssth, rtt, rto, rto_by_rtt and mean_retransmission go to one
+      // binary trace, converted to the .data files after the run, with one
+      // column per traced flow. Each flow is hooked once its source
+      // application has opened the socket.
+      uint32_t traced_flows = trace_all_flows ? num_flows : 1;
+      firstEvent.assign (traced_flows, FirstEvent ());
+      traceWriter = new BinaryTraceWriter (prefix_file_name + "trace.bin", traced_flows);
+      for (uint32_t i = 0; i < traced_flows; i++)
+        {
+          Simulator::Schedule (Seconds (start_time * i + 0.1), &TraceFlow, i);
+        }
 
       //Simulator::Schedule (Seconds (0.1), &TraceNextTx, prefix_file_name + "-next-tx.data");
       //Simulator::Schedule (Seconds (0.1), &TraceInFlight, prefix_file_name + "-inflight.data");
@@ -570,6 +690,19 @@ int main (int argc, char *argv[])
 
     }
 
+  // Every local source reports its RTO statistics once, when its socket
+  // closes or at Simulator::Destroy ()
+  if (rto_stats)
+    {
+      for (uint32_t i = 0; i < num_flows; i++)
+        {
+          if (splitSimulation == nullptr || splitSimulation->IsLocal (sources.Get (i)))
+            {
+              Simulator::Schedule (Seconds (start_time * i + 0.1), &TraceRtoStats, i);
+            }
+        }
+    }
+
   if(pcap){
     PcapHelper pcapHelper;
     Ptr<PcapFileWrapper> file = pcapHelper.CreateFile ("PeakHopper.pcap", std::ios::out, PcapHelper::DLT_PPP);
@@ -578,15 +711,37 @@ int main (int argc, char *argv[])
 
   FlowMonitorHelper flomon;
   Ptr<FlowMonitor>monitor;
+  FlowWindowSampler *sampler = nullptr;
   if(flow_monitor){
     monitor = flomon.InstallAll();
+    if (sample_window > 0)
+      {
+        uint32_t windows = std::ceil (stop_time / sample_window);
+        sampler = new FlowWindowSampler (monitor, Seconds (sample_window), windows + 1);
+        sampler->Start (Seconds (sample_window));
+      }
   }
   Simulator::Stop (Seconds (stop_time));
   Simulator::Run ();
+  if (splitSimulation != nullptr)
+    {
+      splitSimulation->Stop ();
+    }
 
+  if (sampler != nullptr)
+    {
+      sampler->Write (prefix_file_name + "windows.csv");
+      delete sampler;
+    }
   if (flow_monitor)
     {
       FlowMonitor::FlowStatsContainer stats = monitor->GetFlowStats();
+      if (splitSimulation != nullptr)
+        {
+          // Every flow in the first process, even with --processes where it runs
+          // no source; empty in the others
+          stats = splitSimulation->MergeFlowStats (stats, DynamicCast<Ipv4FlowClassifier> (flomon.GetClassifier ()));
+        }
       for(auto iter = stats.begin(); iter != stats.end(); iter++) {
         NS_LOG_UNCOND("----Flow ID:" <<iter->first);
         NS_LOG_UNCOND("Sent Packets = " << iter->second.txPackets);
@@ -601,6 +756,33 @@ int main (int argc, char *argv[])
     }
 
   Simulator::Destroy ();
+
+  if (rto_stats)
+    {
+      // One file per process with several processes
+      std::string name = prefix_file_name + "rto-stats";
+      if (splitSimulation != nullptr)
+        {
+          name += "-" + std::to_string (splitSimulation->GetRank ());
+        }
+      std::ofstream out (name + ".csv");
+      out << "flow,metric,lower,upper,count\n" << rtoStatsRows.str ();
+    }
+  if (traceWriter != nullptr)
+    {
+      traceWriter->Close ();
+      delete traceWriter;
+      traceWriter = nullptr;
+      if (trace_text)
+        {
+          ConvertBinaryTrace (prefix_file_name + "trace.bin", prefix_file_name);
+        }
+    }
+  if (splitSimulation != nullptr)
+    {
+      splitSimulation->Finish ();
+      delete splitSimulation;
+    }
   
   return 0;
 }
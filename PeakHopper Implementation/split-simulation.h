@@ -0,0 +1,773 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Multi-process simulation of simulate.cc (--split, --processes), without
+// MPI.
+//
+// The process forks before the topology is built, so that every process
+// builds the same nodes, addresses and routes. Each node is then given an
+// owner process, which alone runs its applications and receives its frames.
+// Every point-to-point channel between nodes of different owners is replaced
+// by a SplitPointToPointChannel, which hands the frames sent by the local
+// end to the process of the far end through a ring buffer in shared memory.
+//
+// The processes are synchronised conservatively: a frame sent at t over a
+// split channel arrives after t + delay, so all the processes can run a
+// window of the smallest split channel delay independently. At the end of
+// each window a process publishes its window count, waits for the others
+// to reach the same count and schedules the frames sent to it in the
+// completed windows, which all arrive in the next window or later.
+//
+// While waiting, a process only copies frames out of the rings; it
+// schedules them at the barrier, sorted by arrival time, sender and ring
+// order. Every event therefore gets the same place in the event queue from
+// one run to the next, whatever the wall-clock timing of the processes.
+// Frames arrive at the same times as in a single process, but events of the
+// same timestamp on a node may run in a different order than in the serial
+// run.
+
+#ifndef SPLIT_SIMULATION_H
+#define SPLIT_SIMULATION_H
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ns3/abort.h"
+#include "ns3/channel-list.h"
+#include "ns3/flow-monitor.h"
+#include "ns3/ipv4-flow-classifier.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/node-list.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/point-to-point-channel.h"
+#include "ns3/point-to-point-net-device.h"
+#include "ns3/simulator.h"
+
+namespace ns3 {
+
+class SplitSimulation;
+
+static const uint32_t SPLIT_MAX_PROCESSES = 16;      //!< Largest number of processes
+static const uint64_t SPLIT_RING_BYTES = 2 << 20;    //!< Capacity of each ring
+static const uint32_t SPLIT_MAX_FLOWS = 4096;        //!< Flows exchanged per process at the end
+
+/**
+ * \brief Bytes sent from one process to another, single producer and
+ * single consumer
+ */
+struct SplitRing
+{
+  std::atomic<uint64_t> head;             //!< Bytes written, by the producer
+  std::atomic<uint64_t> tail;             //!< Bytes read, by the consumer
+  uint8_t data[SPLIT_RING_BYTES];         //!< Ring storage
+};
+
+/**
+ * \brief Counters of one flow, sent to the first process
+ *
+ * The transmit counters come from the FlowMonitor of the process of the
+ * source, the receive counters from the local deliveries of the process of
+ * the destination.
+ */
+struct SplitFlowRecord
+{
+  Ipv4FlowClassifier::FiveTuple tuple;  //!< Flow
+  uint32_t txPackets;                   //!< Packets sent
+  uint32_t rxPackets;                   //!< Packets received
+  uint64_t txBytes;                     //!< Bytes sent
+  uint64_t rxBytes;                     //!< Bytes received
+  int64_t  timeFirstTx;                 //!< First transmission, in time steps
+  int64_t  timeLastRx;                  //!< Last reception, in time steps
+};
+
+/**
+ * \brief Memory shared by the processes, followed by the rings
+ */
+struct SplitControl
+{
+  std::atomic<uint64_t> window[SPLIT_MAX_PROCESSES];     //!< Windows completed by each process
+  std::atomic<uint32_t> done[SPLIT_MAX_PROCESSES];       //!< Process has left Simulator::Run ()
+  std::atomic<uint32_t> statsReady[SPLIT_MAX_PROCESSES]; //!< flows of the process is filled
+  uint32_t nFlows[SPLIT_MAX_PROCESSES];                  //!< Records in flows
+  SplitFlowRecord flows[SPLIT_MAX_PROCESSES][SPLIT_MAX_FLOWS]; //!< Flow counters
+};
+
+/**
+ * \brief Point-to-point channel whose ends are in different processes
+ *
+ * Frames sent by the local end are given to the SplitSimulation instead of
+ * being scheduled on the far end. The far end is idle in this process,
+ * anything it sends is dropped.
+ */
+class SplitPointToPointChannel : public PointToPointChannel
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::SplitPointToPointChannel")
+      .SetParent<PointToPointChannel> ()
+      .SetGroupName ("PointToPoint")
+      .AddConstructor<SplitPointToPointChannel> ()
+    ;
+    return tid;
+  }
+
+  SplitPointToPointChannel ()
+    : m_split (0)
+  {
+  }
+
+  /**
+   * \brief Set the simulation the channel belongs to
+   * \param split the multi-process simulation
+   */
+  void SetSplit (SplitSimulation *split)
+  {
+    m_split = split;
+  }
+
+  virtual bool TransmitStart (Ptr<const Packet> p, Ptr<PointToPointNetDevice> src, Time txTime);
+
+private:
+  SplitSimulation *m_split;                //!< Multi-process simulation
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SplitPointToPointChannel);
+
+/**
+ * \brief Partition of a simulation over several processes
+ */
+class SplitSimulation
+{
+public:
+  /**
+   * \brief Map the shared memory
+   * \param nProcesses number of processes, 2 to SPLIT_MAX_PROCESSES
+   */
+  SplitSimulation (uint32_t nProcesses)
+    : m_nProcesses (nProcesses),
+      m_rank (0),
+      m_parent (0),
+      m_window (0)
+  {
+    NS_ABORT_MSG_UNLESS (nProcesses >= 2 && nProcesses <= SPLIT_MAX_PROCESSES,
+                         "Between 2 and " << SPLIT_MAX_PROCESSES << " processes");
+    m_size = sizeof (SplitControl) + sizeof (SplitRing) * nProcesses * nProcesses;
+    void *p = mmap (0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    NS_ABORT_MSG_IF (p == MAP_FAILED, "Cannot map the shared memory: " << std::strerror (errno));
+    m_control = new (p) SplitControl;
+    m_rings = reinterpret_cast<SplitRing *> (static_cast<uint8_t *> (p) + sizeof (SplitControl));
+    for (uint32_t r = 0; r < nProcesses; ++r)
+      {
+        m_control->window[r].store (0);
+        m_control->done[r].store (0);
+        m_control->statsReady[r].store (0);
+        m_control->nFlows[r] = 0;
+      }
+    for (uint32_t i = 0; i < nProcesses * nProcesses; ++i)
+      {
+        new (&m_rings[i]) SplitRing;
+        m_rings[i].head.store (0);
+        m_rings[i].tail.store (0);
+      }
+  }
+
+  ~SplitSimulation ()
+  {
+    munmap (m_control, m_size);
+  }
+
+  /**
+   * \brief Start the other processes
+   *
+   * Must be called before any node is created.
+   *
+   * \return the rank of the calling process, 0 for the first one
+   */
+  uint32_t Fork (void)
+  {
+    m_parent = getpid ();
+    for (uint32_t r = 1; r < m_nProcesses; ++r)
+      {
+        pid_t pid = fork ();
+        NS_ABORT_MSG_IF (pid < 0, "fork failed: " << std::strerror (errno));
+        if (pid == 0)
+          {
+            m_rank = r;
+            m_children.clear ();
+            return m_rank;
+          }
+        m_children.push_back (pid);
+      }
+    return m_rank;
+  }
+
+  /**
+   * \brief Get the rank of this process
+   * \return the rank, 0 for the first process
+   */
+  uint32_t GetRank (void) const
+  {
+    return m_rank;
+  }
+
+  /**
+   * \brief Get the number of processes
+   * \return the number of processes
+   */
+  uint32_t GetNProcesses (void) const
+  {
+    return m_nProcesses;
+  }
+
+  /**
+   * \brief Set the process that runs a node, the first one by default
+   * \param node the node
+   * \param rank the rank of its process
+   */
+  void SetOwner (Ptr<Node> node, uint32_t rank)
+  {
+    NS_ABORT_MSG_UNLESS (rank < m_nProcesses, "No process " << rank);
+    if (node->GetId () >= m_owner.size ())
+      {
+        m_owner.resize (node->GetId () + 1, 0);
+      }
+    m_owner[node->GetId ()] = rank;
+  }
+
+  /**
+   * \brief Get the process that runs a node
+   * \param node the node
+   * \return the rank of its process
+   */
+  uint32_t GetOwner (Ptr<Node> node) const
+  {
+    return node->GetId () < m_owner.size () ? m_owner[node->GetId ()] : 0;
+  }
+
+  /**
+   * \brief Check whether this process runs a node
+   * \param node the node
+   * \return true if the node is run by this process
+   */
+  bool IsLocal (Ptr<Node> node) const
+  {
+    return GetOwner (node) == m_rank;
+  }
+
+  /**
+   * \brief Split the point-to-point channels between processes
+   *
+   * Call once the owners are set and every channel is installed. The
+   * devices of each channel between nodes of different owners are attached
+   * to a new SplitPointToPointChannel with the same delay, and the window
+   * barriers are scheduled. The packets delivered to the nodes are counted
+   * for MergeFlowStats ().
+   */
+  void Install (void)
+  {
+    for (NodeList::Iterator i = NodeList::Begin (); i != NodeList::End (); ++i)
+      {
+        Ptr<Ipv4L3Protocol> ipv4 = (*i)->GetObject<Ipv4L3Protocol> ();
+        if (ipv4 != 0)
+          {
+            ipv4->TraceConnectWithoutContext ("LocalDeliver", MakeCallback (&SplitSimulation::LocalDeliver, this));
+          }
+      }
+
+    std::vector<Ptr<PointToPointChannel> > cut;
+    for (ChannelList::Iterator i = ChannelList::Begin (); i != ChannelList::End (); ++i)
+      {
+        Ptr<PointToPointChannel> channel = DynamicCast<PointToPointChannel> (*i);
+        if (channel != 0 && channel->GetNDevices () == 2
+            && GetOwner (channel->GetDevice (0)->GetNode ()) != GetOwner (channel->GetDevice (1)->GetNode ()))
+          {
+            cut.push_back (channel);
+          }
+      }
+    NS_ABORT_MSG_IF (cut.empty (), "No point-to-point link between processes");
+
+    for (uint32_t i = 0; i < cut.size (); ++i)
+      {
+        TimeValue delay;
+        cut[i]->GetAttribute ("Delay", delay);
+        NS_ABORT_MSG_UNLESS (delay.Get ().IsStrictlyPositive (),
+                             "Links between processes need a positive delay");
+        if (i == 0 || delay.Get () < m_lookahead)
+          {
+            m_lookahead = delay.Get ();
+          }
+        Ptr<SplitPointToPointChannel> channel = CreateObject<SplitPointToPointChannel> ();
+        channel->SetAttribute ("Delay", delay);
+        channel->SetSplit (this);
+        Ptr<PointToPointNetDevice> a = cut[i]->GetPointToPointDevice (0);
+        Ptr<PointToPointNetDevice> b = cut[i]->GetPointToPointDevice (1);
+        a->Attach (channel);
+        b->Attach (channel);
+      }
+
+    Simulator::Schedule (m_lookahead, &SplitSimulation::Barrier, this);
+  }
+
+  /**
+   * \brief Give a frame to the process of its destination
+   * \param p the frame
+   * \param dst the receiving device
+   * \param rxTime the time the frame arrives
+   */
+  void Send (Ptr<const Packet> p, Ptr<PointToPointNetDevice> dst, Time rxTime)
+  {
+    uint32_t to = GetOwner (dst->GetNode ());
+    if (m_control->done[to].load (std::memory_order_acquire) != 0)
+      {
+        return; // Arrives after the end of the simulation
+      }
+    uint32_t size = p->GetSerializedSize ();
+    m_buffer.resize (size);
+    p->Serialize (m_buffer.data (), size);
+    MessageHeader header = {rxTime.GetTimeStep (), m_window, dst->GetNode ()->GetId (), dst->GetIfIndex (), size, 0};
+    uint64_t length = MessageLength (size);
+    NS_ABORT_MSG_IF (length > SPLIT_RING_BYTES, "Frame too large for the split ring");
+
+    SplitRing &ring = Ring (m_rank, to);
+    uint64_t head = ring.head.load (std::memory_order_relaxed);
+    WaitUntil ([&] () {
+      return head + length - ring.tail.load (std::memory_order_acquire) <= SPLIT_RING_BYTES
+             || m_control->done[to].load (std::memory_order_acquire) != 0;
+    });
+    Copy (ring, head, &header, sizeof (header));
+    Copy (ring, head + sizeof (header), m_buffer.data (), size);
+    ring.head.store (head + length, std::memory_order_release);
+  }
+
+  /**
+   * \brief Tell the other processes that this one is done
+   *
+   * Call after Simulator::Run ().
+   */
+  void Stop (void)
+  {
+    m_control->done[m_rank].store (1, std::memory_order_release);
+  }
+
+  /**
+   * \brief Combine the flow counters of all the processes
+   *
+   * FlowMonitor only counts a packet as received in the process that sent
+   * it, and the packets that cross processes lose their FlowMonitor tag,
+   * so its receive counters are left out. A flow is made of the transmit
+   * counters of the FlowMonitor of the process of its source and of the
+   * packets delivered to its destination in the process of the
+   * destination, matched by five-tuple. The other processes publish their
+   * counters and get an empty container. The first one waits for them and
+   * gets the combined counters of every flow, numbered from 1 in the order
+   * of their first transmission, as a single FlowMonitor numbers them. The
+   * classifier does not know these numbers.
+   *
+   * \param stats the FlowMonitor counters of this process
+   * \param classifier the FlowMonitor classifier of this process
+   * \return the combined counters
+   */
+  FlowMonitor::FlowStatsContainer MergeFlowStats (const FlowMonitor::FlowStatsContainer &stats,
+                                                  Ptr<Ipv4FlowClassifier> classifier)
+  {
+    std::map<Ipv4FlowClassifier::FiveTuple, SplitFlowRecord> flows = m_rx;
+    for (FlowMonitor::FlowStatsContainer::const_iterator i = stats.begin (); i != stats.end (); ++i)
+      {
+        if (i->second.txPackets == 0)
+          {
+            continue;
+          }
+        SplitFlowRecord r = SplitFlowRecord ();
+        r.tuple = classifier->FindFlow (i->first);
+        r.txPackets = i->second.txPackets;
+        r.txBytes = i->second.txBytes;
+        r.timeFirstTx = i->second.timeFirstTxPacket.GetTimeStep ();
+        Add (flows, r);
+      }
+
+    if (m_rank != 0)
+      {
+        NS_ABORT_MSG_IF (flows.size () > SPLIT_MAX_FLOWS, "More than " << SPLIT_MAX_FLOWS << " flows in a process");
+        uint32_t n = 0;
+        for (std::map<Ipv4FlowClassifier::FiveTuple, SplitFlowRecord>::const_iterator i = flows.begin ();
+             i != flows.end (); ++i, ++n)
+          {
+            m_control->flows[m_rank][n] = i->second;
+          }
+        m_control->nFlows[m_rank] = n;
+        m_control->statsReady[m_rank].store (1, std::memory_order_release);
+        return FlowMonitor::FlowStatsContainer ();
+      }
+
+    for (uint32_t rank = 1; rank < m_nProcesses; ++rank)
+      {
+        WaitUntil ([this, rank] () {
+          return m_control->statsReady[rank].load (std::memory_order_acquire) != 0;
+        });
+        for (uint32_t n = 0; n < m_control->nFlows[rank]; ++n)
+          {
+            Add (flows, m_control->flows[rank][n]);
+          }
+      }
+
+    std::vector<const SplitFlowRecord *> order;
+    for (std::map<Ipv4FlowClassifier::FiveTuple, SplitFlowRecord>::const_iterator i = flows.begin ();
+         i != flows.end (); ++i)
+      {
+        order.push_back (&i->second);
+      }
+    // Flows never sent from a process go last, ties in five-tuple order
+    std::stable_sort (order.begin (), order.end (), [] (const SplitFlowRecord *a, const SplitFlowRecord *b) {
+      if ((a->txPackets == 0) != (b->txPackets == 0))
+        {
+          return b->txPackets == 0;
+        }
+      return a->timeFirstTx < b->timeFirstTx;
+    });
+    FlowMonitor::FlowStatsContainer merged;
+    for (uint32_t i = 0; i < order.size (); ++i)
+      {
+        FlowMonitor::FlowStats &s = merged[i + 1];
+        s.txPackets = order[i]->txPackets;
+        s.rxPackets = order[i]->rxPackets;
+        s.txBytes = order[i]->txBytes;
+        s.rxBytes = order[i]->rxBytes;
+        s.timeFirstTxPacket = TimeStep (order[i]->timeFirstTx);
+        s.timeLastRxPacket = TimeStep (order[i]->timeLastRx);
+      }
+    return merged;
+  }
+
+  /**
+   * \brief Wait for the other processes to exit
+   *
+   * Call at the end of the first process.
+   */
+  void Finish (void)
+  {
+    for (uint32_t i = 0; i < m_children.size (); ++i)
+      {
+        int status;
+        waitpid (m_children[i], &status, 0);
+        NS_ABORT_MSG_UNLESS (WIFEXITED (status) && WEXITSTATUS (status) == 0,
+                             "Process " << i + 1 << " failed");
+      }
+  }
+
+private:
+  /// Frame header in a ring, followed by the serialized packet
+  struct MessageHeader
+  {
+    int64_t  rxTime;    //!< Arrival time, in time steps
+    uint64_t window;    //!< Window of the sender when the frame was sent
+    uint32_t node;      //!< Node of the receiving device
+    uint32_t ifIndex;   //!< Receiving device
+    uint32_t size;      //!< Serialized packet size
+    uint32_t pad;       //!< Keeps the header 8-byte aligned
+  };
+
+  /// Frame taken out of a ring, waiting for its barrier
+  struct StagedFrame
+  {
+    int64_t  rxTime;            //!< Arrival time, in time steps
+    uint64_t window;            //!< Window of the sender when the frame was sent
+    uint32_t from;              //!< Rank of the sender
+    uint64_t offset;            //!< Position in the ring of the sender
+    uint32_t node;              //!< Node of the receiving device
+    uint32_t ifIndex;           //!< Receiving device
+    std::vector<uint8_t> data;  //!< Serialized packet
+  };
+
+  /**
+   * \brief Add the counters of a flow to the record of its five-tuple
+   * \param flows the records
+   * \param r the counters
+   */
+  static void Add (std::map<Ipv4FlowClassifier::FiveTuple, SplitFlowRecord> &flows, const SplitFlowRecord &r)
+  {
+    std::map<Ipv4FlowClassifier::FiveTuple, SplitFlowRecord>::iterator i = flows.find (r.tuple);
+    if (i == flows.end ())
+      {
+        flows.insert (std::make_pair (r.tuple, r));
+        return;
+      }
+    SplitFlowRecord &s = i->second;
+    if (r.txPackets > 0 && (s.txPackets == 0 || r.timeFirstTx < s.timeFirstTx))
+      {
+        s.timeFirstTx = r.timeFirstTx;
+      }
+    if (r.rxPackets > 0 && (s.rxPackets == 0 || r.timeLastRx > s.timeLastRx))
+      {
+        s.timeLastRx = r.timeLastRx;
+      }
+    s.txPackets += r.txPackets;
+    s.rxPackets += r.rxPackets;
+    s.txBytes += r.txBytes;
+    s.rxBytes += r.rxBytes;
+  }
+
+  /**
+   * \brief Count a packet delivered to a node, as FlowMonitor does
+   *
+   * Only TCP and UDP packets make flows, as with Ipv4FlowClassifier. The
+   * size includes the IP header.
+   *
+   * \param ipHeader the IP header
+   * \param ipPayload the packet without the IP header
+   * \param interface the receiving interface
+   */
+  void LocalDeliver (const Ipv4Header &ipHeader, Ptr<const Packet> ipPayload, uint32_t interface)
+  {
+    uint8_t protocol = ipHeader.GetProtocol ();
+    if ((protocol != 6 && protocol != 17) || ipPayload->GetSize () < 4)
+      {
+        return;
+      }
+    uint8_t ports[4];
+    ipPayload->CopyData (ports, 4);
+    SplitFlowRecord r = SplitFlowRecord ();
+    r.tuple.sourceAddress = ipHeader.GetSource ();
+    r.tuple.destinationAddress = ipHeader.GetDestination ();
+    r.tuple.protocol = protocol;
+    r.tuple.sourcePort = (ports[0] << 8) | ports[1];
+    r.tuple.destinationPort = (ports[2] << 8) | ports[3];
+    r.rxPackets = 1;
+    r.rxBytes = ipPayload->GetSize () + ipHeader.GetSerializedSize ();
+    r.timeLastRx = Simulator::Now ().GetTimeStep ();
+    Add (m_rx, r);
+  }
+
+  static uint64_t MessageLength (uint32_t size)
+  {
+    return (sizeof (MessageHeader) + size + 7) & ~static_cast<uint64_t> (7);
+  }
+
+  static void Copy (SplitRing &ring, uint64_t offset, const void *src, uint64_t n)
+  {
+    uint64_t at = offset % SPLIT_RING_BYTES;
+    uint64_t first = std::min (n, SPLIT_RING_BYTES - at);
+    std::memcpy (ring.data + at, src, first);
+    std::memcpy (ring.data, static_cast<const uint8_t *> (src) + first, n - first);
+  }
+
+  static void Copy (void *dst, const SplitRing &ring, uint64_t offset, uint64_t n)
+  {
+    uint64_t at = offset % SPLIT_RING_BYTES;
+    uint64_t first = std::min (n, SPLIT_RING_BYTES - at);
+    std::memcpy (dst, ring.data + at, first);
+    std::memcpy (static_cast<uint8_t *> (dst) + first, ring.data, n - first);
+  }
+
+  SplitRing &Ring (uint32_t from, uint32_t to)
+  {
+    return m_rings[from * m_nProcesses + to];
+  }
+
+  /**
+   * \brief Copy the frames sent by the other processes out of the rings
+   *
+   * Only frees room in the rings: the frames are scheduled by Deliver (),
+   * at a barrier, so that their events do not depend on when they were
+   * copied.
+   */
+  void Drain (void)
+  {
+    for (uint32_t from = 0; from < m_nProcesses; ++from)
+      {
+        if (from == m_rank)
+          {
+            continue;
+          }
+        SplitRing &ring = Ring (from, m_rank);
+        uint64_t tail = ring.tail.load (std::memory_order_relaxed);
+        uint64_t head = ring.head.load (std::memory_order_acquire);
+        while (tail != head)
+          {
+            MessageHeader header;
+            Copy (&header, ring, tail, sizeof (header));
+            StagedFrame frame;
+            frame.rxTime = header.rxTime;
+            frame.window = header.window;
+            frame.from = from;
+            frame.offset = tail;
+            frame.node = header.node;
+            frame.ifIndex = header.ifIndex;
+            frame.data.resize (header.size);
+            Copy (frame.data.data (), ring, tail + sizeof (header), header.size);
+            tail += MessageLength (header.size);
+            m_staged.push_back (std::move (frame));
+          }
+        ring.tail.store (tail, std::memory_order_release);
+      }
+  }
+
+  /**
+   * \brief Schedule the frames sent in the windows completed by all
+   *
+   * The frames sent in earlier windows are all staged once every process
+   * has completed the current one. They are scheduled by arrival time,
+   * then rank of the sender, then order in its ring, whatever the time
+   * they were copied at. Frames of later windows, from processes already
+   * ahead, wait for the next barrier. The frames always arrive in the
+   * future, since they were sent at least one window ago.
+   */
+  void Deliver (void)
+  {
+    std::vector<StagedFrame>::iterator ready =
+      std::stable_partition (m_staged.begin (), m_staged.end (), [this] (const StagedFrame &f) {
+        return f.window < m_window;
+      });
+    std::sort (m_staged.begin (), ready, [] (const StagedFrame &a, const StagedFrame &b) {
+      if (a.rxTime != b.rxTime)
+        {
+          return a.rxTime < b.rxTime;
+        }
+      if (a.from != b.from)
+        {
+          return a.from < b.from;
+        }
+      return a.offset < b.offset;
+    });
+    for (std::vector<StagedFrame>::iterator f = m_staged.begin (); f != ready; ++f)
+      {
+        Ptr<Packet> p = Create<Packet> (f->data.data (), f->data.size (), true);
+        // The tags of the sending process, such as the FlowMonitor tag
+        // with its flow numbering, mean nothing in this one
+        p->RemoveAllPacketTags ();
+        p->RemoveAllByteTags ();
+        Ptr<PointToPointNetDevice> dst =
+          DynamicCast<PointToPointNetDevice> (NodeList::GetNode (f->node)->GetDevice (f->ifIndex));
+        Time delay = TimeStep (f->rxTime) - Simulator::Now ();
+        NS_ASSERT_MSG (!delay.IsNegative (), "Frame from another process arrives in the past");
+        Simulator::ScheduleWithContext (f->node, delay, &PointToPointNetDevice::Receive, dst, p);
+      }
+    m_staged.erase (m_staged.begin (), ready);
+  }
+
+  /**
+   * \brief End of a window: wait for the other processes and take their
+   * frames
+   */
+  void Barrier (void)
+  {
+    ++m_window;
+    m_control->window[m_rank].store (m_window, std::memory_order_release);
+    for (uint32_t other = 0; other < m_nProcesses; ++other)
+      {
+        WaitUntil ([this, other] () {
+          return m_control->window[other].load (std::memory_order_acquire) >= m_window
+                 || m_control->done[other].load (std::memory_order_acquire) != 0;
+        });
+      }
+    Drain ();
+    Deliver ();
+    Simulator::Schedule (m_lookahead, &SplitSimulation::Barrier, this);
+  }
+
+  /**
+   * \brief Spin until a condition on the shared memory holds
+   *
+   * The frames of the other processes are copied out meanwhile, since they
+   * may be waiting for room in their rings.
+   *
+   * \param ready the condition
+   */
+  template <typename Ready>
+  void WaitUntil (Ready ready)
+  {
+    while (!ready ())
+      {
+        Drain ();
+        std::this_thread::yield ();
+        NS_ABORT_MSG_IF (PeerGone () && !ready (), "Another process exited");
+      }
+  }
+
+  /**
+   * \brief Check whether another process has exited
+   * \return true if the first process, or any process for the first one,
+   *         has exited
+   */
+  bool PeerGone (void) const
+  {
+    if (m_rank != 0)
+      {
+        return getppid () != m_parent;
+      }
+    for (uint32_t i = 0; i < m_children.size (); ++i)
+      {
+        // Leave the children waitable for Finish ()
+        siginfo_t info;
+        std::memset (&info, 0, sizeof (info));
+        if (waitid (P_PID, m_children[i], &info, WEXITED | WNOHANG | WNOWAIT) == 0
+            && info.si_pid == m_children[i])
+          {
+            return true;
+          }
+      }
+    return false;
+  }
+
+  uint32_t m_nProcesses;                 //!< Number of processes
+  uint32_t m_rank;                       //!< Rank of this process
+  pid_t m_parent;                        //!< The first process
+  std::vector<pid_t> m_children;         //!< The other processes, in the first one
+  size_t m_size;                         //!< Size of the shared memory
+  SplitControl *m_control;               //!< Shared memory
+  SplitRing *m_rings;                    //!< Ring from i to j at i * m_nProcesses + j
+  std::vector<uint32_t> m_owner;         //!< Rank running each node, by node id
+  Time m_lookahead;                      //!< Window length, the smallest split delay
+  uint64_t m_window;                     //!< Windows completed
+  std::vector<uint8_t> m_buffer;         //!< Serialization buffer
+  std::vector<StagedFrame> m_staged;     //!< Frames copied out of the rings, not scheduled yet
+  std::map<Ipv4FlowClassifier::FiveTuple, SplitFlowRecord> m_rx; //!< Packets delivered to the local nodes
+};
+
+inline bool
+SplitPointToPointChannel::TransmitStart (Ptr<const Packet> p, Ptr<PointToPointNetDevice> src, Time txTime)
+{
+  if (m_split->IsLocal (src->GetNode ()))
+    {
+      Ptr<PointToPointNetDevice> dst = GetPointToPointDevice (src == GetPointToPointDevice (0) ? 1 : 0);
+      m_split->Send (p, dst, Simulator::Now () + txTime + GetDelay ());
+    }
+  return true;
+}
+
+} // namespace ns3
+
+#endif /* SPLIT_SIMULATION_H */
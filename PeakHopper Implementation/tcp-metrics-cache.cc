@@ -0,0 +1,153 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "tcp-metrics-cache.h"
+#include "ns3/boolean.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpMetricsCache");
+
+TcpMetrics::TcpMetrics ()
+  : srtt (Time (0)),
+    rttVar (Time (0)),
+    minRtt (Time::Max ()),
+    boost (0),
+    rttMax (Time (0)),
+    stamp (Time (0))
+{
+}
+
+bool
+TcpMetrics::IsValid (void) const
+{
+  return srtt.IsStrictlyPositive ();
+}
+
+void
+TcpMetrics::Set (const Time &s, const Time &var, const Time &min, double b, const Time &max)
+{
+  srtt = s;
+  rttVar = var;
+  minRtt = std::min (minRtt, min);
+  if (max.IsStrictlyPositive ())
+    {
+      boost = b;
+      rttMax = max;
+    }
+  stamp = Simulator::Now ();
+}
+
+void
+TcpMetrics::Merge (const Time &s, const Time &var, const Time &min, double b, const Time &max)
+{
+  if (!IsValid () || s >= srtt)
+    {
+      srtt = s;
+    }
+  else
+    {
+      srtt -= (srtt - s) / 8;
+    }
+  if (!IsValid () || var >= rttVar)
+    {
+      rttVar = var;
+    }
+  else
+    {
+      rttVar -= (rttVar - var) / 4;
+    }
+  minRtt = std::min (minRtt, min);
+  if (max.IsStrictlyPositive ())
+    {
+      boost = b;
+      rttMax = max;
+    }
+  stamp = Simulator::Now ();
+}
+
+NS_OBJECT_ENSURE_REGISTERED (TcpMetricsCache);
+
+TypeId
+TcpMetricsCache::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpMetricsCache")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpMetricsCache> ()
+    .AddAttribute ("Timeout", "Age after which the metrics of a destination are forgotten",
+                   TimeValue (Seconds (3600)),
+                   MakeTimeAccessor (&TcpMetricsCache::m_timeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("ShareLive",
+                   "Write every RTT sample to the cache, so that new connections start "
+                   "from the state of the running ones to the same host",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpMetricsCache::m_shareLive),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+TcpMetricsCache::TcpMetricsCache ()
+  : Object ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpMetricsCache::~TcpMetricsCache ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Ptr<TcpMetrics>
+TcpMetricsCache::Get (const Address &peer)
+{
+  NS_LOG_FUNCTION (this << peer);
+  Ptr<TcpMetrics> &m = m_entries[peer];
+  if (m == nullptr || Simulator::Now () - m->stamp > m_timeout)
+    {
+      // Running connections keep the old entry, if any
+      m = Create<TcpMetrics> ();
+      m->stamp = Simulator::Now ();
+    }
+  return m;
+}
+
+bool
+TcpMetricsCache::IsShareLive (void) const
+{
+  return m_shareLive;
+}
+
+uint32_t
+TcpMetricsCache::GetSize (void) const
+{
+  return static_cast<uint32_t> (m_entries.size ());
+}
+
+void
+TcpMetricsCache::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_entries.clear ();
+}
+
+} // namespace ns3
@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef TCP_METRICS_CACHE_H
+#define TCP_METRICS_CACHE_H
+
+#include <map>
+
+#include "ns3/address.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/simple-ref-count.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief RTT metrics of one destination
+ *
+ * A zero SRTT means that nothing is known about the destination yet.
+ */
+class TcpMetrics : public SimpleRefCount<TcpMetrics>
+{
+public:
+  TcpMetrics ();
+
+  /**
+   * \brief Check if the metrics can seed a connection
+   * \return true if an SRTT was stored
+   */
+  bool IsValid (void) const;
+
+  /**
+   * \brief Store the state of a connection that is still running
+   *
+   * B and RTT_max are left alone if max is zero, i.e. when the connection
+   * does not use TcpRtoPeakHopper.
+   *
+   * \param s smoothed RTT
+   * \param var RTT variation
+   * \param min minimum RTT
+   * \param b PeakHopper boost factor B
+   * \param max PeakHopper RTT_max
+   */
+  void Set (const Time &s, const Time &var, const Time &min, double b, const Time &max);
+
+  /**
+   * \brief Merge the state of a closing connection, as Linux tcp_update_metrics
+   *
+   * A larger SRTT or RTTVAR replaces the stored one, a smaller one only
+   * moves it by 1/8 (SRTT) or 1/4 (RTTVAR): overestimating the RTT is
+   * safer than underestimating it. The minimum RTT is the smallest seen,
+   * B and RTT_max are the latest ones, as in Set ().
+   *
+   * \param s smoothed RTT
+   * \param var RTT variation
+   * \param min minimum RTT
+   * \param b PeakHopper boost factor B
+   * \param max PeakHopper RTT_max
+   */
+  void Merge (const Time &s, const Time &var, const Time &min, double b, const Time &max);
+
+public:
+  Time   srtt;    //!< Smoothed RTT
+  Time   rttVar;  //!< RTT variation
+  Time   minRtt;  //!< Minimum RTT
+  double boost;   //!< PeakHopper boost factor B
+  Time   rttMax;  //!< PeakHopper RTT_max
+  Time   stamp;   //!< Time of the last update
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Per-destination cache of RTT metrics, after Linux tcp_metrics
+ *
+ * Aggregate one instance to a Node to enable it. The sockets of the node
+ * look it up when they connect, or when a listening socket forks, and
+ * start from the SRTT, RTTVAR, minimum RTT and PeakHopper history stored
+ * for the peer address instead of RttEstimator::InitialEstimation and
+ * the connection timeout. Closing sockets merge their state back.
+ *
+ * With ShareLive, every RTT sample is also written to the entry, so that
+ * a connection opened while others to the same host are running starts
+ * from their current state (RFC 2140 ensemble sharing). Running
+ * connections never read the entry.
+ */
+class TcpMetricsCache : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpMetricsCache ();
+  virtual ~TcpMetricsCache ();
+
+  /**
+   * \brief Get the metrics of a destination, creating an empty entry if needed
+   *
+   * An entry that was not updated for Timeout is emptied first.
+   *
+   * \param peer the address of the destination (Ipv4Address or Ipv6Address)
+   * \return the entry, kept alive by the caller even if it leaves the cache
+   */
+  Ptr<TcpMetrics> Get (const Address &peer);
+
+  /**
+   * \brief Check if running connections write every sample to the cache
+   * \return the ShareLive attribute
+   */
+  bool IsShareLive (void) const;
+
+  /**
+   * \brief Get the number of destinations in the cache
+   * \return the number of entries
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * \brief Remove every entry
+   */
+  void Flush (void);
+
+private:
+  std::map<Address, Ptr<TcpMetrics> > m_entries; //!< Metrics by destination
+  Time m_timeout;                                //!< Age after which an entry is emptied
+  bool m_shareLive;                              //!< Write every RTT sample to the entry
+};
+
+} // namespace ns3
+
+#endif /* TCP_METRICS_CACHE_H */
@@ -0,0 +1,335 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include "tcp-rto-ops.h"
+#include "rtt-estimator.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpRtoOps");
+
+NS_OBJECT_ENSURE_REGISTERED (TcpRtoOps);
+
+TypeId
+TcpRtoOps::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpRtoOps")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+  ;
+  return tid;
+}
+
+TcpRtoOps::TcpRtoOps () : Object ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoOps::TcpRtoOps (const TcpRtoOps &other) : Object (other)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoOps::~TcpRtoOps ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+TcpRtoOps::RttSample (Ptr<const RttEstimator> rtt, const Time &sample)
+{
+  NS_LOG_FUNCTION (this << rtt << sample);
+}
+
+// RFC 6298
+
+NS_OBJECT_ENSURE_REGISTERED (TcpRtoRfc6298);
+
+TypeId
+TcpRtoRfc6298::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpRtoRfc6298")
+    .SetParent<TcpRtoOps> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpRtoRfc6298> ()
+  ;
+  return tid;
+}
+
+TcpRtoRfc6298::TcpRtoRfc6298 (void) : TcpRtoOps ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoRfc6298::TcpRtoRfc6298 (const TcpRtoRfc6298& other)
+  : TcpRtoOps (other)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoRfc6298::~TcpRtoRfc6298 (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+std::string
+TcpRtoRfc6298::GetName () const
+{
+  return "TcpRtoRfc6298";
+}
+
+Time
+TcpRtoRfc6298::GetRto (Ptr<const RttEstimator> rtt, const Time &clockGranularity,
+                       const Time &minRto) const
+{
+  // RFC 6298, clause 2.3
+  return Max (rtt->GetEstimate () + Max (clockGranularity, rtt->GetVariation () * 4), minRto);
+}
+
+Ptr<TcpRtoOps>
+TcpRtoRfc6298::Fork (void)
+{
+  return CopyObject<TcpRtoRfc6298> (this);
+}
+
+// PeakHopper
+
+NS_OBJECT_ENSURE_REGISTERED (TcpRtoPeakHopper);
+
+TypeId
+TcpRtoPeakHopper::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpRtoPeakHopper")
+    .SetParent<TcpRtoOps> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpRtoPeakHopper> ()
+    .AddAttribute ("InitialBoost", "Initial value of the boost factor B (history only, does not affect the RTO)",
+                   DoubleValue (0.75),
+                   MakeDoubleAccessor (&TcpRtoPeakHopper::m_boost),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("Decay", "Per-sample decay of the boost factor, 1 - S/F (history only, does not affect the RTO)",
+                   DoubleValue (1.0 - 1.0 / 16),
+                   MakeDoubleAccessor (&TcpRtoPeakHopper::m_decay),
+                   MakeDoubleChecker<double> (0, 1))
+  ;
+  return tid;
+}
+
+TcpRtoPeakHopper::TcpRtoPeakHopper (void)
+  : TcpRtoOps (),
+    m_lastRtt (Time (0)),
+    m_rttMax (Time (0))
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoPeakHopper::TcpRtoPeakHopper (const TcpRtoPeakHopper& other)
+  : TcpRtoOps (other),
+    m_lastRtt (other.m_lastRtt),
+    m_rttMax (other.m_rttMax),
+    m_boost (other.m_boost),
+    m_decay (other.m_decay)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoPeakHopper::~TcpRtoPeakHopper (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+std::string
+TcpRtoPeakHopper::GetName () const
+{
+  return "TcpRtoPeakHopper";
+}
+
+void
+TcpRtoPeakHopper::RttSample (Ptr<const RttEstimator> rtt, const Time &sample)
+{
+  NS_LOG_FUNCTION (this << rtt << sample);
+
+  if (!m_lastRtt.IsZero ())
+    {
+      // B <- max (D * B, (RTT - RTT_l) / RTT_l)
+      double del = (sample.GetSeconds () - m_lastRtt.GetSeconds ()) / m_lastRtt.GetSeconds ();
+      m_boost = std::max (m_boost * m_decay, del);
+    }
+  m_rttMax = Max (sample, m_lastRtt);
+  m_lastRtt = rtt->GetEstimate ();
+}
+
+Time
+TcpRtoPeakHopper::GetRto (Ptr<const RttEstimator> rtt, const Time &clockGranularity,
+                          const Time &minRto) const
+{
+  return Max (rtt->GetEstimate () + rtt->GetVariation (), m_lastRtt + clockGranularity * 2);
+}
+
+Ptr<TcpRtoOps>
+TcpRtoPeakHopper::Fork (void)
+{
+  return CopyObject<TcpRtoPeakHopper> (this);
+}
+
+double
+TcpRtoPeakHopper::GetBoost (void) const
+{
+  return m_boost;
+}
+
+Time
+TcpRtoPeakHopper::GetRttMax (void) const
+{
+  return m_rttMax;
+}
+
+void
+TcpRtoPeakHopper::SetHistory (double boost, const Time &rttMax, const Time &lastRtt)
+{
+  NS_LOG_FUNCTION (this << boost << rttMax << lastRtt);
+  m_boost = boost;
+  m_rttMax = rttMax;
+  m_lastRtt = lastRtt;
+}
+
+// Linux
+
+NS_OBJECT_ENSURE_REGISTERED (TcpRtoLinux);
+
+TypeId
+TcpRtoLinux::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpRtoLinux")
+    .SetParent<TcpRtoOps> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpRtoLinux> ()
+    .AddAttribute ("MinRttVar", "Lower bound of the variation term (tcp_rto_min)",
+                   TimeValue (MilliSeconds (200)),
+                   MakeTimeAccessor (&TcpRtoLinux::m_minRttVar),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxRto", "Upper bound of the retransmission timeout",
+                   TimeValue (Seconds (120)),
+                   MakeTimeAccessor (&TcpRtoLinux::m_maxRto),
+                   MakeTimeChecker ())
+  ;
+  return tid;
+}
+
+TcpRtoLinux::TcpRtoLinux (void) : TcpRtoOps ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoLinux::TcpRtoLinux (const TcpRtoLinux& other)
+  : TcpRtoOps (other),
+    m_minRttVar (other.m_minRttVar),
+    m_maxRto (other.m_maxRto)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoLinux::~TcpRtoLinux (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+std::string
+TcpRtoLinux::GetName () const
+{
+  return "TcpRtoLinux";
+}
+
+Time
+TcpRtoLinux::GetRto (Ptr<const RttEstimator> rtt, const Time &clockGranularity,
+                     const Time &minRto) const
+{
+  // __tcp_set_rto (): srtt + rttvar, where rttvar never drops below tcp_rto_min
+  Time rto = rtt->GetEstimate () + Max (rtt->GetVariation () * 4, m_minRttVar);
+  return Min (rto, m_maxRto);
+}
+
+Ptr<TcpRtoOps>
+TcpRtoLinux::Fork (void)
+{
+  return CopyObject<TcpRtoLinux> (this);
+}
+
+// Eifel
+
+NS_OBJECT_ENSURE_REGISTERED (TcpRtoEifel);
+
+TypeId
+TcpRtoEifel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpRtoEifel")
+    .SetParent<TcpRtoOps> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpRtoEifel> ()
+  ;
+  return tid;
+}
+
+TcpRtoEifel::TcpRtoEifel (void)
+  : TcpRtoOps (),
+    m_lastSample (Time (0))
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoEifel::TcpRtoEifel (const TcpRtoEifel& other)
+  : TcpRtoOps (other),
+    m_lastSample (other.m_lastSample)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRtoEifel::~TcpRtoEifel (void)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+std::string
+TcpRtoEifel::GetName () const
+{
+  return "TcpRtoEifel";
+}
+
+void
+TcpRtoEifel::RttSample (Ptr<const RttEstimator> rtt, const Time &sample)
+{
+  NS_LOG_FUNCTION (this << rtt << sample);
+  m_lastSample = sample;
+}
+
+Time
+TcpRtoEifel::GetRto (Ptr<const RttEstimator> rtt, const Time &clockGranularity,
+                     const Time &minRto) const
+{
+  return Max (rtt->GetEstimate () + rtt->GetVariation (), m_lastSample + clockGranularity * 2);
+}
+
+Ptr<TcpRtoOps>
+TcpRtoEifel::Fork (void)
+{
+  return CopyObject<TcpRtoEifel> (this);
+}
+
+} // namespace ns3
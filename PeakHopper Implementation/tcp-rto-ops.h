@@ -0,0 +1,297 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef TCP_RTO_OPS_H
+#define TCP_RTO_OPS_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+class RttEstimator;
+
+/**
+ * \ingroup tcp
+ * \defgroup rtoOps Retransmission timeout algorithms.
+ *
+ * The algorithms used to turn the RTT estimation into a retransmission
+ * timeout. The interface is defined in class TcpRtoOps.
+ */
+
+/**
+ * \ingroup rtoOps
+ *
+ * \brief Retransmission timeout abstract class
+ *
+ * The design is inspired by the TcpCongestionOps and TcpRecoveryOps classes.
+ * TcpSocketBase feeds every valid RTT sample to RttSample (), after the
+ * RttEstimator has been updated, and asks GetRto () whenever the
+ * retransmission timer has to be (re)armed. Exponential backoff is still
+ * applied by the socket on timeout.
+ *
+ * Each socket owns its own instance, obtained through Fork () when a
+ * listening socket spawns a new connection.
+ */
+class TcpRtoOps : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   */
+  TcpRtoOps ();
+
+  /**
+   * \brief Copy constructor.
+   * \param other object to copy.
+   */
+  TcpRtoOps (const TcpRtoOps &other);
+
+  /**
+   * \brief Deconstructor
+   */
+  virtual ~TcpRtoOps ();
+
+  /**
+   * \brief Get the name of the RTO algorithm
+   *
+   * \return A string identifying the name
+   */
+  virtual std::string GetName () const = 0;
+
+  /**
+   * \brief Take into account a new RTT sample
+   *
+   * Called after the estimator has been updated with the same sample.
+   * The default implementation does nothing.
+   *
+   * \param rtt the (already updated) RTT estimator of the socket
+   * \param sample the RTT sample
+   */
+  virtual void RttSample (Ptr<const RttEstimator> rtt, const Time &sample);
+
+  /**
+   * \brief Compute the retransmission timeout
+   *
+   * \param rtt the RTT estimator of the socket
+   * \param clockGranularity the clock granularity of the socket
+   * \param minRto the minimum RTO configured on the socket
+   * \return the retransmission timeout, before any backoff
+   */
+  virtual Time GetRto (Ptr<const RttEstimator> rtt, const Time &clockGranularity,
+                       const Time &minRto) const = 0;
+
+  /**
+   * \brief Copy the RTO algorithm across socket
+   *
+   * \return a pointer of the copied object
+   */
+  virtual Ptr<TcpRtoOps> Fork () = 0;
+};
+
+/**
+ * \ingroup rtoOps
+ *
+ * \brief The RFC 6298 retransmission timeout
+ *
+ * RTO = SRTT + max (G, 4 * RTTVAR), bounded below by the socket MinRto.
+ */
+class TcpRtoRfc6298 : public TcpRtoOps
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpRtoRfc6298 ();
+
+  /**
+   * \brief Copy constructor.
+   * \param other object to copy.
+   */
+  TcpRtoRfc6298 (const TcpRtoRfc6298 &other);
+
+  virtual ~TcpRtoRfc6298 ();
+
+  virtual std::string GetName () const;
+
+  virtual Time GetRto (Ptr<const RttEstimator> rtt, const Time &clockGranularity,
+                       const Time &minRto) const;
+
+  virtual Ptr<TcpRtoOps> Fork ();
+};
+
+/**
+ * \ingroup rtoOps
+ *
+ * \brief The PeakHopper retransmission timeout
+ *
+ * RTO = max (SRTT + RTTVAR, RTT_l + 2 * G), where RTT_l is the RTT estimate
+ * after the last sample. It is meant to be used together with the PeakHopper
+ * gains of RttMeanDeviation. The class also tracks the decaying boost
+ * factor B and the peak RTT, i.e. the larger of the last sample and RTT_l.
+ * B and RTT_max do not affect the RTO: they are only exported, through
+ * GetBoost () and GetRttMax (), for TcpMetricsCache to carry them over to
+ * later connections. InitialBoost and Decay only shape that history.
+ */
+class TcpRtoPeakHopper : public TcpRtoOps
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpRtoPeakHopper ();
+
+  /**
+   * \brief Copy constructor.
+   * \param other object to copy.
+   */
+  TcpRtoPeakHopper (const TcpRtoPeakHopper &other);
+
+  virtual ~TcpRtoPeakHopper ();
+
+  virtual std::string GetName () const;
+
+  virtual void RttSample (Ptr<const RttEstimator> rtt, const Time &sample);
+
+  virtual Time GetRto (Ptr<const RttEstimator> rtt, const Time &clockGranularity,
+                       const Time &minRto) const;
+
+  virtual Ptr<TcpRtoOps> Fork ();
+
+  /**
+   * \brief Get the current boost factor
+   * \return B
+   */
+  double GetBoost (void) const;
+
+  /**
+   * \brief Get the larger of the last RTT sample and RTT_l
+   * \return RTT_max
+   */
+  Time GetRttMax (void) const;
+
+  /**
+   * \brief Start from the history of an earlier connection
+   * \param boost the boost factor B
+   * \param rttMax RTT_max
+   * \param lastRtt RTT_l
+   */
+  void SetHistory (double boost, const Time &rttMax, const Time &lastRtt);
+
+private:
+  Time   m_lastRtt;  //!< RTT estimate after the last sample (RTT_l)
+  Time   m_rttMax;   //!< Larger of the last RTT sample and RTT_l
+  double m_boost;    //!< Boost factor B
+  double m_decay;    //!< Per-sample decay of B, (1 - S/F)
+};
+
+/**
+ * \ingroup rtoOps
+ *
+ * \brief Linux-style retransmission timeout
+ *
+ * Linux keeps the variation term above tcp_rto_min, so that
+ * RTO = SRTT + max (4 * RTTVAR, MinRttVar), and caps the result to MaxRto.
+ * The socket MinRto is not applied.
+ */
+class TcpRtoLinux : public TcpRtoOps
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpRtoLinux ();
+
+  /**
+   * \brief Copy constructor.
+   * \param other object to copy.
+   */
+  TcpRtoLinux (const TcpRtoLinux &other);
+
+  virtual ~TcpRtoLinux ();
+
+  virtual std::string GetName () const;
+
+  virtual Time GetRto (Ptr<const RttEstimator> rtt, const Time &clockGranularity,
+                       const Time &minRto) const;
+
+  virtual Ptr<TcpRtoOps> Fork ();
+
+private:
+  Time m_minRttVar; //!< Lower bound of the variation term (tcp_rto_min)
+  Time m_maxRto;    //!< Upper bound of the RTO (TCP_RTO_MAX)
+};
+
+/**
+ * \ingroup rtoOps
+ *
+ * \brief The Eifel retransmission timer
+ *
+ * RTO = max (SRTT + RTTVAR, RTT + 2 * G), where RTT is the most recent
+ * sample. Ludwig and Sklower, "The Eifel Retransmission Timer", CCR 2000.
+ * The Eifel gains are provided by RttMeanDeviation with the PeakHopper
+ * option enabled.
+ */
+class TcpRtoEifel : public TcpRtoOps
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpRtoEifel ();
+
+  /**
+   * \brief Copy constructor.
+   * \param other object to copy.
+   */
+  TcpRtoEifel (const TcpRtoEifel &other);
+
+  virtual ~TcpRtoEifel ();
+
+  virtual std::string GetName () const;
+
+  virtual void RttSample (Ptr<const RttEstimator> rtt, const Time &sample);
+
+  virtual Time GetRto (Ptr<const RttEstimator> rtt, const Time &clockGranularity,
+                       const Time &minRto) const;
+
+  virtual Ptr<TcpRtoOps> Fork ();
+
+private:
+  Time m_lastSample; //!< Most recent RTT sample
+};
+
+} // namespace ns3
+
+#endif /* TCP_RTO_OPS_H */
@@ -43,6 +43,7 @@
 #include "ns3/trace-source-accessor.h"
 #include "ns3/data-rate.h"
 #include "ns3/object.h"
+#include "ns3/object-factory.h"
 #include "tcp-socket-base.h"
 #include "tcp-l4-protocol.h"
 #include "ipv4-end-point.h"
@@ -58,10 +59,14 @@
 #include "tcp-option-sack.h"
 #include "tcp-congestion-ops.h"
 #include "tcp-recovery-ops.h"
+#include "tcp-rto-ops.h"
 #include "ns3/tcp-rate-ops.h"
 
 #include <math.h>
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <ostream>
 
 namespace ns3 {
 
@@ -69,14 +74,6 @@ NS_LOG_COMPONENT_DEFINE ("TcpSocketBase");
 
 NS_OBJECT_ENSURE_REGISTERED (TcpSocketBase);
 
-Time lastRtt = Time (0.0);
-double B = 0.75;
-double w = 0.0;
-double ratio = 0.0;
-//DoubleValue ratio {0.0};
-uint32_t cnt_m_rto_update= 1;
-uint32_t total_retransmit = 0;
-
 TypeId
 TcpSocketBase::GetTypeId (void)
 {
@@ -161,9 +158,34 @@ TcpSocketBase::GetTypeId (void)
                    MakeEnumChecker (TcpSocketState::Off, "Off",
                                     TcpSocketState::On, "On",
                                     TcpSocketState::AcceptOnly, "AcceptOnly"))
-    .AddAttribute ("m_peakHopper", "Enable or disable peakHopper option",
+    .AddAttribute ("RtoType",
+                   "TypeId of the algorithm used to compute the retransmission timeout",
+                   TypeIdValue (TcpRtoRfc6298::GetTypeId ()),
+                   MakeTypeIdAccessor (&TcpSocketBase::SetRtoType,
+                                       &TcpSocketBase::GetRtoType),
+                   MakeTypeIdChecker ())
+    .AddAttribute ("LazyRetxTimer",
+                   "Keep one retransmission event per socket and move its deadline on new ACKs, "
+                   "instead of cancelling and rescheduling it",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_lazyRetxTimer),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SpuriousRtoDetection",
+                   "Detect spurious retransmission timeouts (Eifel with timestamps, F-RTO "
+                   "without, D-SACK with SACK) and undo their cwnd and ssthresh reduction",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_spuriousRtoDetection),
+                   MakeBooleanChecker ())
+    .AddAttribute ("RackTlp",
+                   "Detect losses from the send times of the segments (RACK) and probe "
+                   "tail losses before the RTO (TLP), as in RFC 8985. Needs SACK",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_rackTlp),
+                   MakeBooleanChecker ())
+    .AddAttribute ("m_peakHopper", "Enable or disable peakHopper option (installs ns3::TcpRtoPeakHopper)",
                    BooleanValue (false),
-                   MakeBooleanAccessor (&TcpSocketBase::m_peakHopper),
+                   MakeBooleanAccessor (&TcpSocketBase::SetPeakHopper,
+                                        &TcpSocketBase::GetPeakHopper),
                    MakeBooleanChecker ())
     .AddAttribute("no_of_retransmit" , "count of how many retransmit",
                     UintegerValue (0),
@@ -193,6 +215,14 @@ TcpSocketBase::GetTypeId (void)
                      "Last RTT sample",
                      MakeTraceSourceAccessor (&TcpSocketBase::m_lastRttTrace),
                      "ns3::TracedValueCallback::Time")
+    .AddTraceSource ("RtoExpired",
+                     "Retransmission timeout expired, with the RTO that expired",
+                     MakeTraceSourceAccessor (&TcpSocketBase::m_rtoExpiredTrace),
+                     "ns3::Time::TracedCallback")
+    .AddTraceSource ("RtoStats",
+                     "RTO statistics of the connection, once it ends",
+                     MakeTraceSourceAccessor (&TcpSocketBase::m_rtoStatsTrace),
+                     "ns3::TcpSocketBase::RtoStatsTracedCallback")
       
     .AddTraceSource ("NextTxSequence",
                      "Next sequence number to send (SND.NXT)",
@@ -342,6 +372,9 @@ TcpSocketBase::TcpSocketBase (void)
 TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
   : TcpSocket (sock),
     //copy object::m_tid and socket::callbacks
+    m_peakHopper (sock.m_peakHopper),
+    m_phState (sock.m_phState),
+    m_lazyRetxTimer (sock.m_lazyRetxTimer),
     m_dupAckCount (sock.m_dupAckCount),
     m_delAckCount (0),
     m_delAckMaxCount (sock.m_delAckMaxCount),
@@ -383,6 +416,8 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
     m_recoverActive (sock.m_recoverActive),
     m_retxThresh (sock.m_retxThresh),
     m_limitedTx (sock.m_limitedTx),
+    m_spuriousRtoDetection (sock.m_spuriousRtoDetection),
+    m_rackTlp (sock.m_rackTlp),
     m_isFirstPartialAck (sock.m_isFirstPartialAck),
     m_txTrace (sock.m_txTrace),
     m_rxTrace (sock.m_rxTrace),
@@ -425,6 +460,11 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
       m_recoveryOps = sock.m_recoveryOps->Fork ();
     }
 
+  if (sock.m_rtoOps)
+    {
+      m_rtoOps = sock.m_rtoOps->Fork ();
+    }
+
   m_rateOps = CreateObject <TcpRateLinux> ();
   if (m_tcb->m_sendEmptyPacketCallback.IsNull ())
     {
@@ -749,6 +789,10 @@ TcpSocketBase::Connect (const Address & address)
 
   // Re-initialize parameters in case this socket is being reused after CLOSE
   m_rtt->Reset ();
+  LoadMetrics ();
+  m_rtoStats = RtoStats ();
+  m_rtoStats.Progress (Simulator::Now ());
+  m_rtoStatsReported = false;
   m_synCount = m_synRetries;
   m_dataRetrCount = m_dataRetries;
 
@@ -1609,6 +1653,7 @@ TcpSocketBase::EnterCwr (uint32_t currentDelivered)
   NS_LOG_FUNCTION (this << currentDelivered);
   m_tcb->m_ssThresh = m_congestionControl->GetSsThresh (m_tcb, BytesInFlight ());
   NS_LOG_DEBUG ("Reduce ssThresh to " << m_tcb->m_ssThresh);
+  m_rtoUndoState = RTO_UNDO_NONE; // A new congestion event, nothing left to undo
   // Do not update m_cWnd, under assumption that recovery process will
   // gradually bring it down to m_ssThresh.  Update the 'inflated' value of
   // cWnd used for tracing, however.
@@ -1638,6 +1683,9 @@ TcpSocketBase::EnterRecovery (uint32_t currentDelivered)
 
   NS_LOG_DEBUG (TcpSocketState::TcpCongStateName[m_tcb->m_congState] <<
                 " -> CA_RECOVERY");
+  m_rtoUndoState = RTO_UNDO_NONE; // A new congestion event, nothing left to undo
+  m_tlpEvent.Cancel ();
+  m_tlpOutstanding = false;
 
   if (!m_sackEnabled)
     {
@@ -1843,6 +1891,16 @@ TcpSocketBase::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
 
   m_txBuffer->DiscardUpTo (ackNumber, MakeCallback (&TcpRateOps::SkbDelivered, m_rateOps));
 
+  bool frtoNewData = false;
+  if (m_rtoUndoState != RTO_UNDO_NONE)
+    {
+      frtoNewData = DetectSpuriousRto (tcpHeader, ackNumber, oldHeadSequence);
+    }
+  if (m_rackTlp)
+    {
+      RackOnAck (tcpHeader, ackNumber);
+    }
+
   uint32_t currentDelivered = static_cast<uint32_t> (m_rateOps->GetConnectionRate ().m_delivered - previousDelivered);
   m_tcb->m_lastAckedSackedBytes = currentDelivered;
 
@@ -1888,6 +1946,21 @@ TcpSocketBase::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
   ProcessAck (ackNumber, (bytesSacked > 0), currentDelivered, oldHeadSequence);
   m_tcb->m_isRetransDataAcked = false;
 
+  if (frtoNewData && SendFrtoNewData () == 0)
+    {
+      // Nothing new to send, F-RTO cannot tell
+      ConfirmRto ();
+    }
+
+  if (m_tlpOutstanding)
+    {
+      ProcessTlpAck (tcpHeader, ackNumber, oldHeadSequence, (bytesSacked > 0), currentDelivered);
+    }
+  if (m_rackTlp)
+    {
+      RackDetectLoss (currentDelivered);
+    }
+
   if (m_congestionControl->HasCongControl ())
     {
       uint32_t currentLost = m_txBuffer->GetLost ();
@@ -1909,6 +1982,11 @@ TcpSocketBase::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
   // RFC 6675, Section 5, point (C), try to send more data. NB: (C) is implemented
   // inside SendPendingData
   SendPendingData (m_connected);
+
+  if (m_rackTlp)
+    {
+      ScheduleTlp ();
+    }
 }
 
 void
@@ -2657,20 +2735,8 @@ TcpSocketBase::DoPeerClose (void)
     {
       m_dataRetrCount = m_dataRetries; // prevent endless FINs
       NS_LOG_LOGIC ("TcpSocketBase " << this << " scheduling LATO1");
-      //Time lastRto = m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4);
-      //---------------added by afnan--------------------------
-      Time lastRto;
-      if(m_peakHopper){
-        lastRto = Max(m_rtt->GetEstimate ()
-         +(Time::FromDouble (m_rtt->GetVariation ().ToDouble (Time::S),
-          Time::S)), lastRtt + 2*m_clockGranularity);
-        NS_LOG_INFO("Its peakHopper----------------------------------------------------------------------------------");
-      }
-      else{
-        lastRto = m_rtt->GetEstimate ()
-         + Max (m_clockGranularity, m_rtt->GetVariation () * 4);
-        NS_LOG_INFO("Not peakHopper----------------------------------------------------------------------------------");
-      }
+      // The LAST_ACK timer is not bounded by MinRto
+      Time lastRto = m_rtoOps->GetRto (m_rtt, m_clockGranularity, Time (0));
       m_lastAckEvent = Simulator::Schedule (lastRto, &TcpSocketBase::LastAckTimeout, this);
     }
 }
@@ -2681,6 +2747,7 @@ void
 TcpSocketBase::Destroy (void)
 {
   NS_LOG_FUNCTION (this);
+  ReportRtoStats ();
   m_endPoint = nullptr;
   if (m_tcp != nullptr)
     {
@@ -2697,6 +2764,7 @@ void
 TcpSocketBase::Destroy6 (void)
 {
   NS_LOG_FUNCTION (this);
+  ReportRtoStats ();
   m_endPoint6 = nullptr;
   if (m_tcp != nullptr)
     {
@@ -2750,17 +2818,7 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
   AddOptions (header);
 
   // RFC 6298, clause 2.4
-  //m_rto = Max (m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4), m_minRto);
-      //----------------added by afnan-----------------------------
-      if(m_peakHopper){
-        m_rto = Max(m_rtt->GetEstimate () +(Time::FromDouble (m_rtt->GetVariation ().ToDouble (Time::S) , Time::S)), lastRtt + 2*m_clockGranularity);
-        NS_LOG_INFO("Its peakHopper----------------------------------------------------------------------------------");
-      }
-      else{
-        m_rto = Max (m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4), m_minRto);
-        NS_LOG_INFO("Not peakHopper----------------------------------------------------------------------------------");
-      }
-
+  m_rto = m_rtoOps->GetRto (m_rtt, m_clockGranularity, m_minRto);
 
   uint16_t windowSize = AdvertisedWindowSize ();
   bool hasSyn = flags & TcpHeader::SYN;
@@ -2788,9 +2846,10 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
           return;
         }
       else
-        { // Exponential backoff of connection time out
+        { // Exponential backoff of connection time out, or of the RTO
+          // of the cached RTT of the peer
           int backoffCount = 0x1 << (m_synRetries - m_synCount);
-          m_rto = m_cnTimeout * backoffCount;
+          m_rto = (m_metricsSeeded ? m_rto.Get () : m_cnTimeout) * backoffCount;
           m_synCount--;
         }
 
@@ -2815,7 +2874,7 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
         {
           m_highTxAck = header.GetAckNumber ();
         }
-      if (m_sackEnabled && m_tcb->m_rxBuffer->GetSackListSize () > 0)
+      if (m_sackEnabled && (m_tcb->m_rxBuffer->GetSackListSize () > 0 || m_dsackPending))
         {
           AddOptionSack (header);
         }
@@ -2842,6 +2901,7 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
                     << Simulator::Now ().GetSeconds () << " to expire at time "
                     << (Simulator::Now () + m_rto.Get ()).GetSeconds ());
       m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::SendEmptyPacket, this, flags);
+      m_retxFireTime = Time::Max (); // Not a RetxTimerExpired event
     }
 }
 
@@ -2859,6 +2919,10 @@ TcpSocketBase::SendRST (void)
 void
 TcpSocketBase::DeallocateEndPoint (void)
 {
+  StoreMetrics (true);
+  ReportRtoStats ();
+  m_metrics = nullptr;
+  m_metricsShared = false;
   if (m_endPoint != nullptr)
     {
       CancelAllTimers ();
@@ -2877,6 +2941,90 @@ TcpSocketBase::DeallocateEndPoint (void)
     }
 }
 
+void
+TcpSocketBase::LoadMetrics (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_metrics = nullptr;
+  m_metricsShared = false;
+  m_metricsSeeded = false;
+  Ptr<TcpMetricsCache> cache = m_node->GetObject<TcpMetricsCache> ();
+  if (cache == nullptr)
+    {
+      return;
+    }
+  if (m_endPoint != nullptr)
+    {
+      m_metrics = cache->Get (m_endPoint->GetPeerAddress ());
+    }
+  else if (m_endPoint6 != nullptr)
+    {
+      m_metrics = cache->Get (m_endPoint6->GetPeerAddress ());
+    }
+  else
+    {
+      return;
+    }
+  m_metricsShared = cache->IsShareLive ();
+  if (!m_metrics->IsValid ())
+    {
+      return;
+    }
+
+  m_rtt->Seed (m_metrics->srtt, m_metrics->rttVar);
+  m_tcb->m_minRtt = m_metrics->minRtt;
+  m_phState.lastRtt = m_metrics->srtt;
+  Ptr<TcpRtoPeakHopper> peakHopper = DynamicCast<TcpRtoPeakHopper> (m_rtoOps);
+  if (peakHopper != nullptr && m_metrics->rttMax.IsStrictlyPositive ())
+    {
+      peakHopper->SetHistory (m_metrics->boost, m_metrics->rttMax, m_metrics->srtt);
+    }
+  m_metricsSeeded = true;
+  NS_LOG_INFO ("Cached metrics: srtt " << m_metrics->srtt << ", rttvar " <<
+               m_metrics->rttVar << ", min rtt " << m_metrics->minRtt);
+}
+
+void
+TcpSocketBase::StoreMetrics (bool closing)
+{
+  NS_LOG_FUNCTION (this << closing);
+  if (m_metrics == nullptr || m_tcb->m_minRtt == Time::Max ())
+    {
+      return; // No cache, or no RTT sample
+    }
+  double boost = 0;
+  Time rttMax (0);
+  Ptr<TcpRtoPeakHopper> peakHopper = DynamicCast<TcpRtoPeakHopper> (m_rtoOps);
+  if (peakHopper != nullptr)
+    {
+      boost = peakHopper->GetBoost ();
+      rttMax = peakHopper->GetRttMax ();
+    }
+  if (closing)
+    {
+      m_metrics->Merge (m_rtt->GetEstimate (), m_rtt->GetVariation (), m_tcb->m_minRtt, boost, rttMax);
+    }
+  else
+    {
+      m_metrics->Set (m_rtt->GetEstimate (), m_rtt->GetVariation (), m_tcb->m_minRtt, boost, rttMax);
+    }
+}
+
+void
+TcpSocketBase::ReportRtoStats (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_rtoStatsReported || m_state == LISTEN)
+    {
+      return;
+    }
+  m_rtoStatsReported = true;
+  m_rtoStats.Finish ();
+  NS_LOG_INFO ("RTO statistics: " << m_rtoStats.timeouts << " timeouts in " <<
+               m_rtoStats.episodes << " episodes, " << m_rtoStats.spurious << " spurious");
+  m_rtoStatsTrace (m_rtoStats);
+}
+
 /* Configure the endpoint to a local address. Called by Connect() if Bind() didn't specify one. */
 int
 TcpSocketBase::SetupEndpoint ()
@@ -2967,6 +3115,7 @@ TcpSocketBase::CompleteFork (Ptr<Packet> p, const TcpHeader& h,
       m_endPoint = nullptr;
     }
   m_tcp->AddSocket (this);
+  LoadMetrics ();
 
   // Change the cloned socket from LISTEN state to SYN_RCVD
   NS_LOG_DEBUG ("LISTEN -> SYN_RCVD");
@@ -3184,7 +3333,14 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
       NS_LOG_LOGIC (this << " SendDataPacket Schedule ReTxTimeout at time " <<
                     Simulator::Now ().GetSeconds () << " to expire at time " <<
                     (Simulator::Now () + m_rto.Get ()).GetSeconds () );
-      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
+      if (m_lazyRetxTimer)
+        {
+          RestartRetxTimer ();
+        }
+      else
+        {
+          m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
+        }
     }
 
   m_txTrace (p, header, this);
@@ -3207,6 +3363,15 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
     }
 
   UpdateRttHistory (seq, sz, isRetransmission);
+  if (m_rackTlp && m_sackEnabled)
+    {
+      RackSent (seq, sz, isRetransmission);
+    }
+
+  if (isRetransmission && m_rtoUndoState != RTO_UNDO_NONE && seq < m_undoRecover)
+    {
+      m_undoRetrans += sz;
+    }
 
   // Update bytes sent during recovery phase
   if (m_tcb->m_congState == TcpSocketState::CA_RECOVERY || m_tcb->m_congState == TcpSocketState::CA_CWR)
@@ -3222,6 +3387,11 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
     }
   // Update highTxMark
   m_tcb->m_highTxMark = std::max (seq + sz, m_tcb->m_highTxMark.Get ());
+
+  if (m_rackTlp && !m_tlpEvent.IsRunning ())
+    {
+      ScheduleTlp ();
+    }
   return sz;
 }
 
@@ -3234,18 +3404,15 @@ TcpSocketBase::UpdateRttHistory (const SequenceNumber32 &seq, uint32_t sz,
   // update the history of sequence numbers used to calculate the RTT
   if (isRetransmission == false)
     { // This is the next expected one, just log at end
-      m_history.push_back (RttHistory (seq, sz, Simulator::Now ()));
+      m_history.PushBack (RttHistory (seq, sz, Simulator::Now ()));
     }
   else
     { // This is a retransmit, find in list and mark as re-tx
-      for (std::deque<RttHistory>::iterator i = m_history.begin (); i != m_history.end (); ++i)
-        {
-          if ((seq >= i->seq) && (seq < (i->seq + SequenceNumber32 (i->count))))
-            { // Found it
-              i->retx = true;
-              i->count = ((seq + SequenceNumber32 (sz)) - i->seq); // And update count in hist
-              break;
-            }
+      RttHistory *h = m_history.Find (seq);
+      if (h != nullptr)
+        { // Found it
+          h->retx = true;
+          h->count = ((seq + SequenceNumber32 (sz)) - h->seq); // And update count in hist
         }
     }
 }
@@ -3496,6 +3663,15 @@ TcpSocketBase::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
   SequenceNumber32 expectedSeq = m_tcb->m_rxBuffer->NextRxSequence ();
   if (!m_tcb->m_rxBuffer->Add (p, tcpHeader))
     { // Insert failed: No data or RX buffer full
+      SequenceNumber32 seq = tcpHeader.GetSequenceNumber ();
+      if ((m_spuriousRtoDetection || m_rackTlp) && m_sackEnabled && p->GetSize () > 0
+          && seq + SequenceNumber32 (p->GetSize ()) <= expectedSeq)
+        {
+          // Already received: report it in the ACK (RFC 2883)
+          m_dsackStart = seq;
+          m_dsackEnd = seq + SequenceNumber32 (p->GetSize ());
+          m_dsackPending = true;
+        }
       if (m_tcb->m_ecnState == TcpSocketState::ECN_CE_RCVD || m_tcb->m_ecnState == TcpSocketState::ECN_SENDING_ECE)
         {
           SendEmptyPacket (TcpHeader::ACK | TcpHeader::ECE);
@@ -3581,86 +3757,73 @@ void
 TcpSocketBase::EstimateRtt (const TcpHeader& tcpHeader)
 {
   SequenceNumber32 ackSeq = tcpHeader.GetAckNumber ();
-  Time m = Time (0.0);
-
-  // An ack has been received, calculate rtt and log this measurement
-  // Note we use a linear search (O(n)) for this since for the common
-  // case the ack'ed packet will be at the head of the list
-  if (!m_history.empty ())
-    {
-      RttHistory& h = m_history.front ();
-      if (!h.retx && ackSeq >= (h.seq + SequenceNumber32 (h.count)))
+  bool useTs = m_timestampEnabled && tcpHeader.HasOption (TcpOption::TS);
+  bool tsEligible = false;
+  m_rttSamples.clear ();
+
+  // An ack has been received, calculate rtt and log this measurement.
+  // Delete all ack history with seq <= ack; with delayed, stretch or SACK'ed
+  // ACKs there can be several entries. Each one that was never retransmitted
+  // (Karn) gives a sample, unless the RTT comes from the timestamp echo,
+  // which yields a single sample for the whole ACK. Sampling stops at the
+  // first retransmitted entry: the entries after it were held back by the
+  // hole, and their elapsed time includes the whole recovery.
+  bool karn = false;
+  uint32_t acked = 0;
+  for (; acked < m_history.Size (); ++acked)
+    {
+      RttHistory& h = m_history.At (acked);
+      if ((h.seq + SequenceNumber32 (h.count)) > ackSeq)
+        {
+          break;                                                              // Done removing
+        }
+      if (h.retx)
+        {
+          karn = true;
+        }
+      else if (useTs)
+        { // Ok to use the timestamp echo
+          tsEligible = true;
+        }
+      else if (!karn)
         { // Ok to use this sample
-          if (m_timestampEnabled && tcpHeader.HasOption (TcpOption::TS))
-            {
-              Ptr<const TcpOptionTS> ts;
-              ts = DynamicCast<const TcpOptionTS> (tcpHeader.GetOption (TcpOption::TS));
-              m = TcpOptionTS::ElapsedTimeFromTsValue (ts->GetEcho ());
-              if (m.IsZero ())
-                {
-                  NS_LOG_LOGIC ("TcpSocketBase::EstimateRtt - RTT calculated from TcpOption::TS is zero, approximating to 1us.");
-                  m = MicroSeconds (1);
-                }
-            }
-          else
-            {
-              m = Simulator::Now () - h.time; // Elapsed time
-            }
+          m_rttSamples.push_back (Simulator::Now () - h.time); // Elapsed time
         }
     }
+  m_history.PopFront (acked); // Remove
 
-  // Now delete all ack history with seq <= ack
-  while (!m_history.empty ())
+  if (tsEligible)
     {
-      RttHistory& h = m_history.front ();
-      if ((h.seq + SequenceNumber32 (h.count)) > ackSeq)
+      Ptr<const TcpOptionTS> ts;
+      ts = DynamicCast<const TcpOptionTS> (tcpHeader.GetOption (TcpOption::TS));
+      Time m = TcpOptionTS::ElapsedTimeFromTsValue (ts->GetEcho ());
+      if (m.IsZero ())
         {
-          break;                                                              // Done removing
+          NS_LOG_LOGIC ("TcpSocketBase::EstimateRtt - RTT calculated from TcpOption::TS is zero, approximating to 1us.");
+          m = MicroSeconds (1);
         }
-      m_history.pop_front (); // Remove
-    }
-
-  if (!m.IsZero ())
-    {
-      if(m_peakHopper){
-        m_rtt->Measurement (m);
-        double del = ((m.GetSeconds() - lastRtt.GetSeconds())/lastRtt.GetSeconds());
-        double S = 1;
-        double F = 16;
-        double D = 1-(1/F*S);
-        if(B*D > del)B = B*D;
-        else B = del;
-
-        Time rttMax;
-        if(m.GetSeconds() > lastRtt.GetSeconds())rttMax = m;
-        else rttMax = lastRtt;
-    
-        Time tmp;
-        if(D*(m_rto.Get()).GetSeconds() > (1+B)*rttMax.GetSeconds())tmp = D*m_rto;
-        else tmp = (1+B)*rttMax;
-
-        m_minRto = rttMax + 2*m_clockGranularity;
-        lastRtt = m_rtt->GetEstimate ();
-        //m_rto = Max(D*tmp , (1+B)*rttMax);
-        m_rto = Max (m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4), m_minRto);
-        // m_rto = Max(m_rto , m_minRto);
-        cnt_m_rto_update++;
-        ratio += (m_rto.Get().GetSeconds() / lastRtt.GetSeconds());
-        m_rto_by_rtt = ratio / (cnt_m_rto_update*1.0); //change of this value will invoke rto_by_rttTracer
-        NS_LOG_UNCOND(m_rto_by_rtt);
-       }
-      else{
-        m_rtt->Measurement (m);
-        lastRtt = m_rtt->GetEstimate ();
-        m_rto = Max (m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4), m_minRto);
-        cnt_m_rto_update++;
-        ratio += (m_rto.Get().GetSeconds() / lastRtt.GetSeconds());
-        m_rto_by_rtt = ratio *1.0 / cnt_m_rto_update; 
-        NS_LOG_INFO("Not peakHopper----------------------------------------------------------------------------------");
-      }
+      m_rttSamples.push_back (m);
+    }
+
+  if (!m_rttSamples.empty ())
+    {
+      m_rtt->MeasurementBatch (m_rttSamples);
+      // The RTO algorithm sees the largest sample of the ACK, so that a
+      // delay spike is not hidden by the smaller samples around it
+      m_rtoOps->RttSample (m_rtt, *std::max_element (m_rttSamples.begin (), m_rttSamples.end ()));
+      m_phState.lastRtt = m_rtt->GetEstimate ();
+      m_rto = m_rtoOps->GetRto (m_rtt, m_clockGranularity, m_minRto);
+      m_phState.cntRtoUpdate++;
+      m_phState.ratio += (m_rto.Get().GetSeconds() / m_phState.lastRtt.GetSeconds());
+      m_rto_by_rtt = m_phState.ratio / (m_phState.cntRtoUpdate*1.0); //change of this value will invoke rto_by_rttTracer
+      m_rtoStats.RtoUpdate (m_rto.Get ().GetSeconds () / m_phState.lastRtt.GetSeconds ());
       m_tcb->m_lastRtt = m_rtt->GetEstimate ();
       m_tcb->m_minRtt = std::min (m_tcb->m_lastRtt.Get (), m_tcb->m_minRtt);
       NS_LOG_INFO (this << m_tcb->m_lastRtt << m_tcb->m_minRtt);
+      if (m_metricsShared)
+        {
+          StoreMetrics (false);
+        }
     }
 }
 
@@ -3674,26 +3837,21 @@ TcpSocketBase::NewAck (SequenceNumber32 const& ack, bool resetRTO)
 
   // Reset the data retransmission count. We got a new ACK!
   m_dataRetrCount = m_dataRetries;
+  m_rtoStats.Progress (Simulator::Now ());
 
-  if (m_state != SYN_RCVD && resetRTO)
+  if (m_state != SYN_RCVD && resetRTO && m_lazyRetxTimer)
+    {
+      m_rto = m_rtoOps->GetRto (m_rtt, m_clockGranularity, m_minRto);
+      RestartRetxTimer ();
+    }
+  else if (m_state != SYN_RCVD && resetRTO)
     { // Set RTO unless the ACK is received in SYN_RCVD state
       NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
                     (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
       m_retxEvent.Cancel ();
       // On receiving a "New" ack we restart retransmission timer .. RFC 6298
       // RFC 6298, clause 2.4
-      //----------------added by afnan-----------------------------
-      if(m_peakHopper){
-        m_rto = Max(m_rtt->GetEstimate () 
-        +(Time::FromDouble (m_rtt->GetVariation ().ToDouble (Time::S) ,
-         Time::S)), lastRtt + 2*m_clockGranularity);
-        NS_LOG_INFO("Its peakHopper----------------------------------------------------------------------------------");
-      }
-      else{
-        m_rto = Max (m_rtt->GetEstimate () 
-        + Max (m_clockGranularity, m_rtt->GetVariation () * 4), m_minRto);
-        NS_LOG_INFO("Not peakHopper----------------------------------------------------------------------------------");
-      }
+      m_rto = m_rtoOps->GetRto (m_rtt, m_clockGranularity, m_minRto);
 
       NS_LOG_LOGIC (this << " Schedule ReTxTimeout at time " <<
                     Simulator::Now ().GetSeconds () << " to expire at time " <<
@@ -3721,6 +3879,40 @@ TcpSocketBase::NewAck (SequenceNumber32 const& ack, bool resetRTO)
     }
 }
 
+void
+TcpSocketBase::RestartRetxTimer ()
+{
+  NS_LOG_FUNCTION (this);
+  m_retxDeadline = Simulator::Now () + m_rto.Get ();
+  if (m_retxEvent.IsRunning () && m_retxFireTime <= m_retxDeadline)
+    {
+      NS_LOG_LOGIC (this << " ReTxTimeout deadline moved to " << m_retxDeadline.GetSeconds ());
+      return;
+    }
+  // The RTO shrank, or no timer is running
+  m_retxEvent.Cancel ();
+  m_retxFireTime = m_retxDeadline;
+  NS_LOG_LOGIC (this << " Schedule ReTxTimeout at time " <<
+                Simulator::Now ().GetSeconds () << " to expire at time " <<
+                m_retxDeadline.GetSeconds ());
+  m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::RetxTimerExpired, this);
+}
+
+void
+TcpSocketBase::RetxTimerExpired ()
+{
+  NS_LOG_FUNCTION (this);
+  if (Simulator::Now () < m_retxDeadline)
+    {
+      // Pushed back by the ACKs received since it was scheduled
+      m_retxFireTime = m_retxDeadline;
+      m_retxEvent = Simulator::Schedule (m_retxDeadline - Simulator::Now (),
+                                         &TcpSocketBase::RetxTimerExpired, this);
+      return;
+    }
+  ReTxTimeout ();
+}
+
 // Retransmit timeout
 void
 TcpSocketBase::ReTxTimeout ()
@@ -3732,6 +3924,7 @@ TcpSocketBase::ReTxTimeout ()
     {
       return;
     }
+  m_rtoExpiredTrace (m_rto.Get ());
 
   if (m_state == SYN_SENT)
     {
@@ -3776,11 +3969,44 @@ TcpSocketBase::ReTxTimeout ()
     {
       --m_dataRetrCount;
     }
+  m_rtoStats.Timeout (Simulator::Now ());
+
+  m_tlpEvent.Cancel ();
+  m_tlpOutstanding = false;
+  m_rackReoEvent.Cancel ();
 
   uint32_t inFlightBeforeRto = BytesInFlight ();
   bool resetSack = !m_sackEnabled; // Reset SACK information if SACK is not enabled.
                                    // The information in the TcpTxBuffer is guessed, in this case.
 
+  // Spurious RTO detection starts with the first timeout of a loss episode,
+  // unless it interrupts a fast recovery. Only the head is retransmitted
+  // and marked lost until an ACK tells whether the timeout was spurious,
+  // so that an undo does not have to take back the rest of the window.
+  bool deferLoss = m_spuriousRtoDetection
+    && (m_tcb->m_congState == TcpSocketState::CA_OPEN
+        || m_tcb->m_congState == TcpSocketState::CA_DISORDER);
+  if (deferLoss)
+    {
+      m_undoCwnd = m_tcb->m_cWnd;
+      m_undoSsThresh = m_tcb->m_ssThresh;
+      m_undoRto = m_rto;
+      m_undoTsVal = TcpOptionTS::NowToTsValue ();
+      m_undoRecover = m_tcb->m_highTxMark;
+      m_undoRetrans = 0;
+      m_rtoUndoState = m_timestampEnabled ? RTO_UNDO_EIFEL : RTO_UNDO_FRTO;
+    }
+  else if (m_tcb->m_congState != TcpSocketState::CA_LOSS)
+    {
+      m_rtoUndoState = RTO_UNDO_NONE;
+    }
+  else if (m_rtoUndoState != RTO_UNDO_NONE && m_rtoUndoState != RTO_UNDO_DSACK)
+    {
+      // The retransmission of the head timed out too, only D-SACK can
+      // still show that the episode was spurious
+      m_rtoUndoState = m_sackEnabled ? RTO_UNDO_DSACK : RTO_UNDO_NONE;
+    }
+
   // Reset dupAckCount
   m_dupAckCount = 0;
   if (!m_sackEnabled)
@@ -3800,7 +4026,14 @@ TcpSocketBase::ReTxTimeout ()
   // The head of the sent list will not be marked as sacked, therefore
   // will be retransmitted, if the receiver renegotiate the SACK blocks
   // that we received.
-  m_txBuffer->SetSentListLost (resetSack);
+  if (deferLoss)
+    {
+      m_txBuffer->MarkHeadAsLost ();
+    }
+  else
+    {
+      m_txBuffer->SetSentListLost (resetSack);
+    }
 
   // From RFC 6675, Section 5.1
   // If an RTO occurs during loss recovery as specified in this document,
@@ -3815,7 +4048,7 @@ TcpSocketBase::ReTxTimeout ()
   m_rto = Min (doubledRto, Time::FromDouble (60,  Time::S));
 
   // Empty RTT history
-  m_history.clear ();
+  m_history.Clear ();
 
   // Please don't reset highTxMark, it is used for retransmission detection
 
@@ -3841,6 +4074,13 @@ TcpSocketBase::ReTxTimeout ()
                 m_txBuffer->HeadSequence () << " doubled rto to " <<
                 m_rto.Get ().GetSeconds () << " s");
 
+  if (deferLoss)
+    {
+      // The rest of the window is still in flight, retransmit the head alone
+      DoRetransmit ();
+      return;
+    }
+
   NS_ASSERT_MSG (BytesInFlight () == 0, "There are some bytes in flight after an RTO: " <<
                  BytesInFlight ());
 
@@ -3851,70 +4091,467 @@ TcpSocketBase::ReTxTimeout ()
                  ") there is more than one segment (" << m_tcb->m_segmentSize << ")");
 }
 
+bool
+TcpSocketBase::DetectSpuriousRto (const TcpHeader &tcpHeader, const SequenceNumber32 &ackNumber,
+                                  const SequenceNumber32 &oldHeadSequence)
+{
+  NS_LOG_FUNCTION (this << ackNumber << oldHeadSequence);
+  bool newAck = ackNumber > oldHeadSequence;
+
+  switch (m_rtoUndoState)
+    {
+    case RTO_UNDO_EIFEL:
+      // RFC 3522: an ACK of the original transmission echoes an older
+      // timestamp than the one of the retransmission. Duplicate ACKs do not
+      // acknowledge the head and are ignored in CA_LOSS anyway.
+      if (newAck)
+        {
+          Ptr<const TcpOptionTS> ts = DynamicCast<const TcpOptionTS> (tcpHeader.GetOption (TcpOption::TS));
+          if (ts != nullptr && ts->GetEcho () < m_undoTsVal)
+            {
+              UndoRto ();
+            }
+          else
+            {
+              ConfirmRto ();
+            }
+        }
+      break;
+    case RTO_UNDO_FRTO:
+      // RFC 5682, step 2: a new ACK below the recovery point lets two new
+      // segments out. A duplicate ACK means a conventional recovery, which
+      // starts once the retransmitted head is ACKed.
+      if (!newAck)
+        {
+          m_rtoUndoState = RTO_UNDO_LOSS;
+        }
+      else if (ackNumber < m_undoRecover)
+        {
+          m_rtoUndoState = RTO_UNDO_FRTO_NEW;
+          return true;
+        }
+      else
+        {
+          ConfirmRto ();
+        }
+      break;
+    case RTO_UNDO_FRTO_NEW:
+      // RFC 5682, step 3: only original transmissions can move SND.UNA now
+      if (newAck)
+        {
+          UndoRto ();
+        }
+      else
+        {
+          ConfirmRto ();
+        }
+      break;
+    case RTO_UNDO_LOSS:
+      if (newAck)
+        {
+          ConfirmRto ();
+        }
+      break;
+    case RTO_UNDO_DSACK:
+      {
+        SequenceNumber32 start;
+        SequenceNumber32 end;
+        if (ReadDsack (tcpHeader, ackNumber, &start, &end) && end <= m_undoRecover)
+          {
+            m_undoRetrans = SafeSubtraction (m_undoRetrans, end - start);
+          }
+        // RFC 3708: every retransmission of the episode was a duplicate
+        if (m_undoRetrans == 0 && ackNumber >= m_undoRecover)
+          {
+            UndoRto ();
+          }
+      }
+      break;
+    default:
+      break;
+    }
+  return false;
+}
+
 void
-TcpSocketBase::DelAckTimeout (void)
+TcpSocketBase::UndoRto (void)
 {
-  m_delAckCount = 0;
-  m_congestionControl->CwndEvent (m_tcb, TcpSocketState::CA_EVENT_DELAYED_ACK);
-  if (m_tcb->m_ecnState == TcpSocketState::ECN_CE_RCVD || m_tcb->m_ecnState == TcpSocketState::ECN_SENDING_ECE)
+  NS_LOG_FUNCTION (this);
+  m_tcb->m_cWnd = std::max (m_tcb->m_cWnd.Get (), m_undoCwnd);
+  m_tcb->m_cWndInfl = m_tcb->m_cWnd;
+  m_tcb->m_ssThresh = std::max (m_tcb->m_ssThresh.Get (), m_undoSsThresh);
+  if (m_rtoUndoState != RTO_UNDO_DSACK)
     {
-      SendEmptyPacket (TcpHeader::ACK | TcpHeader::ECE);
-      m_tcb->m_ecnState = TcpSocketState::ECN_SENDING_ECE;
+      // There has been no RTT sample since the timeout, drop the backoff.
+      // D-SACK detects the spurious RTO later, after new samples.
+      m_rto = m_undoRto;
     }
-  else
+  if (m_tcb->m_congState == TcpSocketState::CA_LOSS)
     {
-      SendEmptyPacket (TcpHeader::ACK);
+      m_congestionControl->CongestionStateSet (m_tcb, TcpSocketState::CA_OPEN);
+      m_tcb->m_congState = TcpSocketState::CA_OPEN;
+      m_recoverActive = false;
     }
+  NS_LOG_INFO ("Spurious RTO, restored cwnd " << m_tcb->m_cWnd << ", ssthresh " <<
+               m_tcb->m_ssThresh << ", rto " << m_rto.Get ().GetSeconds () << " s");
+  m_rtoUndoState = RTO_UNDO_NONE;
+  m_rtoStats.Spurious ();
 }
 
 void
-TcpSocketBase::LastAckTimeout (void)
+TcpSocketBase::ConfirmRto (void)
 {
   NS_LOG_FUNCTION (this);
+  m_rtoStats.Genuine ();
+  NS_LOG_INFO ("RTO was not spurious, marking the sent list lost");
+  if (!m_sackEnabled)
+    {
+      m_txBuffer->ResetRenoSack ();
+    }
+  m_txBuffer->SetSentListLost (!m_sackEnabled);
+  m_rtoUndoState = m_sackEnabled ? RTO_UNDO_DSACK : RTO_UNDO_NONE;
+}
 
-  m_lastAckEvent.Cancel ();
-  if (m_state == LAST_ACK)
+uint32_t
+TcpSocketBase::SendFrtoNewData (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t nPacketsSent = 0;
+  while (nPacketsSent < 2)
     {
-      if (m_dataRetrCount == 0)
+      SequenceNumber32 next = m_tcb->m_highTxMark;
+      uint32_t s = std::min (m_tcb->m_segmentSize, m_txBuffer->SizeFromSequence (next));
+      if (s == 0 || (m_highRxAckMark + SequenceNumber32 (m_rWnd)) < (next + SequenceNumber32 (s)))
         {
-          NS_LOG_INFO ("LAST-ACK: No more data retries available. Dropping connection");
-          NotifyErrorClose ();
-          DeallocateEndPoint ();
-          return;
+          break;
         }
-      m_dataRetrCount--;
-      SendEmptyPacket (TcpHeader::FIN | TcpHeader::ACK);
-      NS_LOG_LOGIC ("TcpSocketBase " << this << " rescheduling LATO1");
-      Time lastRto = m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4);
-      m_lastAckEvent = Simulator::Schedule (lastRto, &TcpSocketBase::LastAckTimeout, this);
+      m_tcb->m_nextTxSequence = next;
+      m_tcb->m_nextTxSequence += SendDataPacket (next, s, true);
+      ++nPacketsSent;
     }
+  NS_LOG_DEBUG ("F-RTO sent " << nPacketsSent << " new segments");
+  return nPacketsSent;
 }
 
-// Send 1-byte data to probe for the window size at the receiver when
-// the local knowledge tells that the receiver has zero window size
-// C.f.: RFC793 p.42, RFC1112 sec.4.2.2.17
-void
-TcpSocketBase::PersistTimeout ()
+bool
+TcpSocketBase::ReadDsack (const TcpHeader &tcpHeader, const SequenceNumber32 &ackNumber,
+                          SequenceNumber32 *start, SequenceNumber32 *end) const
 {
-  NS_LOG_LOGIC ("PersistTimeout expired at " << Simulator::Now ().GetSeconds ());
-  m_persistTimeout = std::min (Seconds (60), Time (2 * m_persistTimeout)); // max persist timeout = 60s
-  Ptr<Packet> p = m_txBuffer->CopyFromSequence (1, m_tcb->m_nextTxSequence)->GetPacketCopy ();
-  m_txBuffer->ResetLastSegmentSent ();
-  TcpHeader tcpHeader;
-  tcpHeader.SetSequenceNumber (m_tcb->m_nextTxSequence);
-  tcpHeader.SetAckNumber (m_tcb->m_rxBuffer->NextRxSequence ());
-  tcpHeader.SetWindowSize (AdvertisedWindowSize ());
-  if (m_endPoint != nullptr)
+  // RFC 2883: a first SACK block below the cumulative ACK reports a
+  // duplicate segment
+  Ptr<const TcpOptionSack> sack = DynamicCast<const TcpOptionSack> (tcpHeader.GetOption (TcpOption::SACK));
+  if (sack == nullptr || sack->GetNumSackBlocks () == 0)
     {
-      tcpHeader.SetSourcePort (m_endPoint->GetLocalPort ());
-      tcpHeader.SetDestinationPort (m_endPoint->GetPeerPort ());
+      return false;
     }
-  else
+  TcpOptionSack::SackBlock block = sack->GetSackList ().front ();
+  if (block.second > ackNumber)
     {
-      tcpHeader.SetSourcePort (m_endPoint6->GetLocalPort ());
-      tcpHeader.SetDestinationPort (m_endPoint6->GetPeerPort ());
+      return false;
     }
-  AddOptions (tcpHeader);
+  *start = block.first;
+  *end = block.second;
+  return true;
+}
+
+void
+TcpSocketBase::RackSent (const SequenceNumber32 &seq, uint32_t sz, bool isRetransmission)
+{
+  NS_LOG_FUNCTION (this << seq << sz << isRetransmission);
+  if (!isRetransmission)
+    {
+      m_rackSent.PushBack (RttHistory (seq, sz, Simulator::Now ()));
+      return;
+    }
+  // A retransmission may span several of the original segments
+  SequenceNumber32 end = seq + SequenceNumber32 (sz);
+  for (uint32_t i = m_rackSent.Index (seq); i < m_rackSent.Size () && m_rackSent.At (i).seq < end; ++i)
+    {
+      m_rackSent.At (i).time = Simulator::Now ();
+      m_rackSent.At (i).retx = true;
+    }
+}
+
+void
+TcpSocketBase::RackOnAck (const TcpHeader &tcpHeader, const SequenceNumber32 &ackNumber)
+{
+  NS_LOG_FUNCTION (this << ackNumber);
+  uint32_t acked = 0;
+  while (acked < m_rackSent.Size ()
+         && m_rackSent.At (acked).seq + SequenceNumber32 (m_rackSent.At (acked).count) <= ackNumber)
+    {
+      RackUpdate (m_rackSent.At (acked));
+      ++acked;
+    }
+  m_rackSent.PopFront (acked);
+
+  Ptr<const TcpOptionSack> sack = DynamicCast<const TcpOptionSack> (tcpHeader.GetOption (TcpOption::SACK));
+  if (sack == nullptr)
+    {
+      return;
+    }
+  TcpOptionSack::SackList list = sack->GetSackList ();
+  for (TcpOptionSack::SackList::const_iterator it = list.begin (); it != list.end (); ++it)
+    {
+      if (it->second <= ackNumber)
+        {
+          continue; // D-SACK
+        }
+      uint32_t i = m_rackSent.Index (it->second - 1);
+      if (i < m_rackSent.Size () && m_rackSent.At (i).seq >= it->first)
+        {
+          RackUpdate (m_rackSent.At (i));
+        }
+    }
+}
+
+void
+TcpSocketBase::RackUpdate (const RttHistory &h)
+{
+  Time rtt = Simulator::Now () - h.time;
+  if (h.retx && rtt < m_tcb->m_minRtt)
+    {
+      // Too early for the retransmission, the original was delivered
+      return;
+    }
+  SequenceNumber32 end = h.seq + SequenceNumber32 (h.count);
+  if (h.time > m_rackXmitTime || (h.time == m_rackXmitTime && end > m_rackEndSeq))
+    {
+      m_rackXmitTime = h.time;
+      m_rackEndSeq = end;
+      m_rackRtt = rtt;
+    }
+}
+
+bool
+TcpSocketBase::RackDetectLoss (uint32_t currentDelivered)
+{
+  NS_LOG_FUNCTION (this << currentDelivered);
+  // The sent list cannot mark a segment lost behind the head, so RACK only
+  // starts the recovery. RFC 6675 finds the other losses from there.
+  if ((m_tcb->m_congState != TcpSocketState::CA_OPEN
+       && m_tcb->m_congState != TcpSocketState::CA_DISORDER)
+      || (m_recoverActive && m_highRxAckMark < m_recover)
+      || m_rackSent.Empty ())
+    {
+      return false;
+    }
+
+  // Only a segment sent after the head can tell that the head is missing
+  const RttHistory &head = m_rackSent.Front ();
+  SequenceNumber32 end = head.seq + SequenceNumber32 (head.count);
+  if (head.time > m_rackXmitTime || (head.time == m_rackXmitTime && end >= m_rackEndSeq))
+    {
+      return false;
+    }
+
+  // RFC 8985, Section 6.2, step 4: a quarter of the minimum RTT, at most SRTT
+  Time reoWnd = Min (m_tcb->m_minRtt / 4, m_rtt->GetEstimate ());
+  Time lossTime = head.time + m_rackRtt + reoWnd;
+  if (lossTime > Simulator::Now ())
+    {
+      if (!m_rackReoEvent.IsRunning ())
+        {
+          m_rackReoEvent = Simulator::Schedule (lossTime - Simulator::Now (),
+                                                &TcpSocketBase::RackTimeout, this);
+        }
+      return false;
+    }
+
+  NS_LOG_DEBUG ("RACK deems " << head.seq << " lost, sent at " << head.time.GetSeconds () <<
+                " before " << m_rackEndSeq << " sent at " << m_rackXmitTime.GetSeconds ());
+  m_rackReoEvent.Cancel ();
+  EnterRecovery (currentDelivered);
+  return true;
+}
+
+void
+TcpSocketBase::RackTimeout (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (RackDetectLoss (0))
+    {
+      SendPendingData (m_connected);
+    }
+}
+
+void
+TcpSocketBase::ScheduleTlp (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_tlpEvent.Cancel ();
+  // RFC 8985, Section 7.2: one probe at a time, in the open state
+  if (m_tcb->m_congState != TcpSocketState::CA_OPEN || m_tlpOutstanding
+      || m_rackSent.Empty () || m_rtt->GetNSamples () == 0 || !m_retxEvent.IsRunning ())
+    {
+      return;
+    }
+
+  Time pto = m_rtt->GetEstimate () * 2;
+  if (BytesInFlight () <= m_tcb->m_segmentSize)
+    {
+      // A lone segment may wait for the delayed ACK timer of the peer
+      pto += m_delAckTimeout;
+    }
+  Time rtoLeft = m_lazyRetxTimer ? m_retxDeadline - Simulator::Now ()
+                                 : Simulator::GetDelayLeft (m_retxEvent);
+  if (pto >= rtoLeft)
+    {
+      return;
+    }
+  m_tlpEvent = Simulator::Schedule (pto, &TcpSocketBase::TlpTimeout, this);
+}
+
+void
+TcpSocketBase::TlpTimeout (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_tcb->m_congState != TcpSocketState::CA_OPEN || m_rackSent.Empty ())
+    {
+      return;
+    }
+
+  // RFC 8985, Section 7.3: send a new segment if the peer window allows it,
+  // otherwise retransmit the last one
+  SequenceNumber32 seq = m_tcb->m_highTxMark;
+  uint32_t sz = std::min (m_tcb->m_segmentSize, m_txBuffer->SizeFromSequence (seq));
+  m_tlpRetrans = sz == 0 || (m_highRxAckMark + SequenceNumber32 (m_rWnd)) < (seq + SequenceNumber32 (sz));
+  if (m_tlpRetrans)
+    {
+      const RttHistory &last = m_rackSent.At (m_rackSent.Size () - 1);
+      SequenceNumber32 lastEnd = last.seq + SequenceNumber32 (last.count);
+      if (m_rackEndSeq >= lastEnd)
+        {
+          return; // The tail was SACKed, RACK takes care of the holes
+        }
+      seq = std::max (last.seq, m_txBuffer->HeadSequence ());
+      sz = static_cast<uint32_t> (lastEnd - seq);
+    }
+  NS_LOG_DEBUG ("Tail loss probe " << (m_tlpRetrans ? "retransmits " : "sends ") << seq);
+
+  m_tlpOutstanding = true;
+  m_tcb->m_nextTxSequence = seq;
+  SendDataPacket (seq, sz, true);
+  m_tcb->m_nextTxSequence = m_tcb->m_highTxMark;
+  m_tlpHighSeq = m_tcb->m_highTxMark;
+
+  // The RTO restarts once the probe is out
+  if (m_lazyRetxTimer)
+    {
+      RestartRetxTimer ();
+    }
+  else
+    {
+      m_retxEvent.Cancel ();
+      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
+    }
+}
+
+void
+TcpSocketBase::ProcessTlpAck (const TcpHeader &tcpHeader, const SequenceNumber32 &ackNumber,
+                              const SequenceNumber32 &oldHeadSequence, bool scoreboardUpdated,
+                              uint32_t currentDelivered)
+{
+  NS_LOG_FUNCTION (this << ackNumber);
+  if (ackNumber < m_tlpHighSeq)
+    {
+      return;
+    }
+
+  SequenceNumber32 start;
+  SequenceNumber32 end;
+  if (!m_tlpRetrans)
+    {
+      // The new data of the probe got through, RACK does the rest
+      m_tlpOutstanding = false;
+    }
+  else if (ReadDsack (tcpHeader, ackNumber, &start, &end))
+    {
+      // Both the original and the probe arrived, nothing was lost
+      m_tlpOutstanding = false;
+    }
+  else if (ackNumber > m_tlpHighSeq)
+    {
+      // The probe repaired a loss, reduce the window as for ECN
+      NS_LOG_INFO ("Tail loss probe recovered a loss");
+      m_tlpOutstanding = false;
+      if (m_tcb->m_congState == TcpSocketState::CA_OPEN
+          || m_tcb->m_congState == TcpSocketState::CA_DISORDER)
+        {
+          EnterCwr (currentDelivered);
+        }
+    }
+  else if (ackNumber == oldHeadSequence && !scoreboardUpdated)
+    {
+      // Pure duplicate ACK of the probe, nothing was lost
+      m_tlpOutstanding = false;
+    }
+}
+
+void
+TcpSocketBase::DelAckTimeout (void)
+{
+  m_delAckCount = 0;
+  m_congestionControl->CwndEvent (m_tcb, TcpSocketState::CA_EVENT_DELAYED_ACK);
+  if (m_tcb->m_ecnState == TcpSocketState::ECN_CE_RCVD || m_tcb->m_ecnState == TcpSocketState::ECN_SENDING_ECE)
+    {
+      SendEmptyPacket (TcpHeader::ACK | TcpHeader::ECE);
+      m_tcb->m_ecnState = TcpSocketState::ECN_SENDING_ECE;
+    }
+  else
+    {
+      SendEmptyPacket (TcpHeader::ACK);
+    }
+}
+
+void
+TcpSocketBase::LastAckTimeout (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_lastAckEvent.Cancel ();
+  if (m_state == LAST_ACK)
+    {
+      if (m_dataRetrCount == 0)
+        {
+          NS_LOG_INFO ("LAST-ACK: No more data retries available. Dropping connection");
+          NotifyErrorClose ();
+          DeallocateEndPoint ();
+          return;
+        }
+      m_dataRetrCount--;
+      SendEmptyPacket (TcpHeader::FIN | TcpHeader::ACK);
+      NS_LOG_LOGIC ("TcpSocketBase " << this << " rescheduling LATO1");
+      Time lastRto = m_rtoOps->GetRto (m_rtt, m_clockGranularity, Time (0));
+      m_lastAckEvent = Simulator::Schedule (lastRto, &TcpSocketBase::LastAckTimeout, this);
+    }
+}
+
+// Send 1-byte data to probe for the window size at the receiver when
+// the local knowledge tells that the receiver has zero window size
+// C.f.: RFC793 p.42, RFC1112 sec.4.2.2.17
+void
+TcpSocketBase::PersistTimeout ()
+{
+  NS_LOG_LOGIC ("PersistTimeout expired at " << Simulator::Now ().GetSeconds ());
+  m_persistTimeout = std::min (Seconds (60), Time (2 * m_persistTimeout)); // max persist timeout = 60s
+  Ptr<Packet> p = m_txBuffer->CopyFromSequence (1, m_tcb->m_nextTxSequence)->GetPacketCopy ();
+  m_txBuffer->ResetLastSegmentSent ();
+  TcpHeader tcpHeader;
+  tcpHeader.SetSequenceNumber (m_tcb->m_nextTxSequence);
+  tcpHeader.SetAckNumber (m_tcb->m_rxBuffer->NextRxSequence ());
+  tcpHeader.SetWindowSize (AdvertisedWindowSize ());
+  if (m_endPoint != nullptr)
+    {
+      tcpHeader.SetSourcePort (m_endPoint->GetLocalPort ());
+      tcpHeader.SetDestinationPort (m_endPoint->GetPeerPort ());
+    }
+  else
+    {
+      tcpHeader.SetSourcePort (m_endPoint6->GetLocalPort ());
+      tcpHeader.SetDestinationPort (m_endPoint6->GetPeerPort ());
+    }
+  AddOptions (tcpHeader);
   //Send a packet tag for setting ECT bits in IP header
   if (m_tcb->m_ecnState != TcpSocketState::ECN_DISABLED)
     {
@@ -3978,11 +4615,11 @@ TcpSocketBase::DoRetransmit ()
   uint32_t sz = SendDataPacket (m_tcb->m_nextTxSequence, maxSizeToSend, true);
   
   //-----------------added by afnan-------------------------
-  total_retransmit+=1;
+  m_phState.totalRetransmit+=1;
   //get lastRtt and m_rto to generate sumof W/M
-  w += (m_rto.Get().GetDouble()/lastRtt.GetDouble());
-  //NS_LOG_UNCOND("No of Retransmitted packets : "<<total_retransmit);
-  m_mean_retransmission = w*1.0 / total_retransmit;
+  m_phState.w += (m_rto.Get().GetDouble()/m_phState.lastRtt.GetDouble());
+  //NS_LOG_UNCOND("No of Retransmitted packets : "<<m_phState.totalRetransmit);
+  m_mean_retransmission = m_phState.w*1.0 / m_phState.totalRetransmit;
   NS_ASSERT (sz > 0);
   //------------------------------------------------------
 
@@ -3998,6 +4635,8 @@ TcpSocketBase::CancelAllTimers ()
   m_timewaitEvent.Cancel ();
   m_sendPendingDataEvent.Cancel ();
   m_pacingTimer.Cancel ();
+  m_rackReoEvent.Cancel ();
+  m_tlpEvent.Cancel ();
 }
 
 /* Move TCP to Time_Wait state and schedule a transition to Closed state */
@@ -4007,6 +4646,7 @@ TcpSocketBase::TimeWait ()
   NS_LOG_DEBUG (TcpStateName[m_state] << " -> TIME_WAIT");
   m_state = TIME_WAIT;
   CancelAllTimers ();
+  ReportRtoStats ();
   if (!m_closeNotified)
     {
       // Technically the connection is not fully closed, but we notify now
@@ -4306,6 +4946,12 @@ TcpSocketBase::AddOptionSack (TcpHeader& header)
   uint8_t allowedSackBlocks = (optionLenAvail - 2) / 8;
 
   TcpOptionSack::SackList sackList = m_tcb->m_rxBuffer->GetSackList ();
+  if (m_dsackPending)
+    {
+      // A D-SACK block goes first, and is reported only once
+      sackList.push_front (TcpOptionSack::SackBlock (m_dsackStart, m_dsackEnd));
+      m_dsackPending = false;
+    }
   if (allowedSackBlocks == 0 || sackList.empty ())
     {
       NS_LOG_LOGIC ("No space available or sack list empty, not adding sack blocks");
@@ -4536,6 +5182,45 @@ TcpSocketBase::SetRecoveryAlgorithm (Ptr<TcpRecoveryOps> recovery)
   m_recoveryOps = recovery;
 }
 
+void
+TcpSocketBase::SetRtoAlgorithm (Ptr<TcpRtoOps> rtoOps)
+{
+  NS_LOG_FUNCTION (this << rtoOps);
+  m_rtoOps = rtoOps;
+}
+
+void
+TcpSocketBase::SetRtoType (TypeId rtoType)
+{
+  NS_LOG_FUNCTION (this << rtoType);
+  ObjectFactory rtoFactory;
+  rtoFactory.SetTypeId (rtoType);
+  SetRtoAlgorithm (rtoFactory.Create<TcpRtoOps> ());
+}
+
+TypeId
+TcpSocketBase::GetRtoType (void) const
+{
+  return m_rtoOps ? m_rtoOps->GetInstanceTypeId () : TcpRtoRfc6298::GetTypeId ();
+}
+
+void
+TcpSocketBase::SetPeakHopper (bool peakHopper)
+{
+  NS_LOG_FUNCTION (this << peakHopper);
+  m_peakHopper = peakHopper;
+  if (peakHopper)
+    {
+      SetRtoType (TcpRtoPeakHopper::GetTypeId ());
+    }
+}
+
+bool
+TcpSocketBase::GetPeakHopper (void) const
+{
+  return m_peakHopper;
+}
+
 Ptr<TcpSocketBase>
 TcpSocketBase::Fork (void)
 {
@@ -4680,4 +5365,304 @@ RttHistory::RttHistory (const RttHistory& h)
 {
 }
 
+//RttHistoryBuffer methods
+RttHistoryBuffer::RttHistoryBuffer ()
+  : m_entries (64, RttHistory (SequenceNumber32 (0), 0, Time (0))),
+    m_head (0),
+    m_size (0)
+{
+}
+
+bool
+RttHistoryBuffer::Empty (void) const
+{
+  return m_size == 0;
+}
+
+uint32_t
+RttHistoryBuffer::Size (void) const
+{
+  return m_size;
+}
+
+RttHistory&
+RttHistoryBuffer::Front (void)
+{
+  NS_ASSERT (m_size > 0);
+  return m_entries[m_head];
+}
+
+RttHistory&
+RttHistoryBuffer::At (uint32_t i)
+{
+  NS_ASSERT (i < m_size);
+  return m_entries[(m_head + i) & (m_entries.size () - 1)];
+}
+
+void
+RttHistoryBuffer::PushBack (const RttHistory &h)
+{
+  if (m_size == m_entries.size ())
+    {
+      Grow ();
+    }
+  m_entries[(m_head + m_size) & (m_entries.size () - 1)] = h;
+  ++m_size;
+}
+
+void
+RttHistoryBuffer::PopFront (void)
+{
+  PopFront (1);
+}
+
+void
+RttHistoryBuffer::PopFront (uint32_t n)
+{
+  NS_ASSERT (n <= m_size);
+  m_head = (m_head + n) & (m_entries.size () - 1);
+  m_size -= n;
+}
+
+void
+RttHistoryBuffer::Clear (void)
+{
+  m_head = 0;
+  m_size = 0;
+}
+
+RttHistory*
+RttHistoryBuffer::Find (const SequenceNumber32 &seq)
+{
+  uint32_t i = Index (seq);
+  return i < m_size ? &At (i) : nullptr;
+}
+
+uint32_t
+RttHistoryBuffer::Index (const SequenceNumber32 &seq)
+{
+  if (m_size == 0 || seq < Front ().seq)
+    {
+      return m_size;
+    }
+
+  // Common case: every entry is one full segment
+  const RttHistory &first = Front ();
+  if (first.count > 0)
+    {
+      uint32_t guess = static_cast<uint32_t> (seq - first.seq) / first.count;
+      if (guess < m_size)
+        {
+          const RttHistory &h = At (guess);
+          if (seq >= h.seq && seq < h.seq + SequenceNumber32 (h.count))
+            {
+              return guess;
+            }
+        }
+    }
+
+  // Otherwise look for the last entry starting at or before seq
+  uint32_t lo = 0;
+  uint32_t hi = m_size;
+  while (hi - lo > 1)
+    {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (At (mid).seq <= seq)
+        {
+          lo = mid;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+  const RttHistory &h = At (lo);
+  if (seq >= h.seq && seq < h.seq + SequenceNumber32 (h.count))
+    {
+      return lo;
+    }
+  return m_size;
+}
+
+void
+RttHistoryBuffer::Grow (void)
+{
+  std::vector<RttHistory> entries (m_entries.size () * 2, RttHistory (SequenceNumber32 (0), 0, Time (0)));
+  for (uint32_t i = 0; i < m_size; ++i)
+    {
+      entries[i] = At (i);
+    }
+  m_entries.swap (entries);
+  m_head = 0;
+}
+
+//PeakHopperState methods
+PeakHopperState::PeakHopperState ()
+  : lastRtt (Time (0.0)),
+    w (0.0),
+    ratio (0.0),
+    cntRtoUpdate (1),
+    totalRetransmit (0)
+{
+}
+
+PeakHopperState::PeakHopperState (const PeakHopperState& s)
+  : lastRtt (s.lastRtt),
+    w (s.w),
+    ratio (s.ratio),
+    cntRtoUpdate (s.cntRtoUpdate),
+    totalRetransmit (s.totalRetransmit)
+{
+}
+
+//RtoHistogram methods
+RtoHistogram::RtoHistogram (double base)
+  : m_base (base)
+{
+  std::fill (m_count, m_count + N_BUCKETS, 0);
+}
+
+void
+RtoHistogram::Add (double v)
+{
+  uint32_t i = 0;
+  if (v >= m_base)
+    {
+      double octaves = std::log2 (v / m_base);
+      i = 1 + static_cast<uint32_t> (std::min (octaves * PER_OCTAVE, N_BUCKETS - 2.0));
+    }
+  m_count[i]++;
+}
+
+uint32_t
+RtoHistogram::GetCount (uint32_t i) const
+{
+  return m_count[i];
+}
+
+double
+RtoHistogram::GetLower (uint32_t i) const
+{
+  return i == 0 ? 0 : m_base * std::exp2 ((i - 1) / double (PER_OCTAVE));
+}
+
+double
+RtoHistogram::GetUpper (uint32_t i) const
+{
+  if (i == N_BUCKETS - 1)
+    {
+      return std::numeric_limits<double>::infinity ();
+    }
+  return m_base * std::exp2 (i / double (PER_OCTAVE));
+}
+
+//RtoStats methods
+RtoStats::RtoStats ()
+  : rtoByRtt (0.125),
+    stall (0.001),
+    timeouts (0),
+    episodes (0),
+    spurious (0),
+    genuine (0),
+    m_backoff (0),
+    m_verdict (0),
+    m_lastProgress (Time (0)),
+    m_lastTimeout (Time (0))
+{
+  std::fill (backoff, backoff + MAX_BACKOFF + 1, 0);
+}
+
+void
+RtoStats::RtoUpdate (double ratio)
+{
+  rtoByRtt.Add (ratio);
+}
+
+void
+RtoStats::Timeout (const Time &now)
+{
+  timeouts++;
+  if (m_backoff == 0)
+    {
+      episodes++;
+      m_verdict = 0;
+    }
+  m_backoff++;
+  m_lastTimeout = now;
+}
+
+void
+RtoStats::Progress (const Time &now)
+{
+  if (m_backoff > 0)
+    {
+      stall.Add ((m_lastTimeout - m_lastProgress).GetSeconds ());
+      backoff[std::min (m_backoff, MAX_BACKOFF)]++;
+      m_backoff = 0;
+    }
+  m_lastProgress = now;
+}
+
+void
+RtoStats::Genuine (void)
+{
+  if (m_verdict == 0)
+    {
+      genuine++;
+      m_verdict = 1;
+    }
+}
+
+void
+RtoStats::Spurious (void)
+{
+  if (m_verdict == 1)
+    {
+      genuine--;
+    }
+  if (m_verdict != 2)
+    {
+      spurious++;
+      m_verdict = 2;
+    }
+}
+
+void
+RtoStats::Finish (void)
+{
+  Progress (m_lastProgress);
+}
+
+void
+RtoStats::Write (std::ostream &os, uint32_t flow) const
+{
+  const RtoHistogram *histograms[] = { &rtoByRtt, &stall };
+  const char *names[] = { "rto_by_rtt", "stall" };
+  for (uint32_t h = 0; h < 2; ++h)
+    {
+      for (uint32_t i = 0; i < RtoHistogram::N_BUCKETS; ++i)
+        {
+          if (histograms[h]->GetCount (i) > 0)
+            {
+              os << flow << "," << names[h] << "," << histograms[h]->GetLower (i) << ","
+                 << histograms[h]->GetUpper (i) << "," << histograms[h]->GetCount (i) << "\n";
+            }
+        }
+    }
+  for (uint32_t i = 1; i <= MAX_BACKOFF; ++i)
+    {
+      if (backoff[i] > 0)
+        {
+          // Depth i, the last one also counts deeper backoffs
+          os << flow << ",backoff," << i << "," << (i == MAX_BACKOFF ? "inf" : std::to_string (i + 1))
+             << "," << backoff[i] << "\n";
+        }
+    }
+  os << flow << ",timeouts,,," << timeouts << "\n";
+  os << flow << ",episodes,,," << episodes << "\n";
+  os << flow << ",spurious,,," << spurious << "\n";
+  os << flow << ",genuine,,," << genuine << "\n";
+  os << flow << ",unclassified,,," << episodes - spurious - genuine << "\n";
+}
+
 } // namespace ns3
@@ -23,6 +23,7 @@
 
 #include <stdint.h>
 #include <queue>
+#include <vector>
 #include "ns3/traced-value.h"
 #include "ns3/tcp-socket.h"
 #include "ns3/ipv4-header.h"
@@ -32,6 +33,7 @@
 #include "ns3/data-rate.h"
 #include "ns3/node.h"
 #include "ns3/tcp-socket-state.h"
+#include "ns3/tcp-metrics-cache.h"
 
 namespace ns3 {
 
@@ -43,6 +45,7 @@ class TcpL4Protocol;
 class TcpHeader;
 class TcpCongestionOps;
 class TcpRecoveryOps;
+class TcpRtoOps;
 class RttEstimator;
 class TcpRxBuffer;
 class TcpTxBuffer;
@@ -78,6 +81,255 @@ public:
   bool            retx;   //!< True if this has been retransmitted
 };
 
+/**
+ * \ingroup tcp
+ *
+ * \brief Ring buffer of RttHistory entries, ordered by sequence number
+ *
+ * Entries are appended in sequence order as new data is sent and trimmed
+ * from the head as data is acknowledged, so both ends are O(1) and the
+ * entry covering a sequence number is found with an O(1) guess (all
+ * segments of the same size) or a binary search. The storage is a
+ * power-of-two array that is reused: steady-state operation does not
+ * allocate, the array only doubles when more segments are outstanding
+ * than it can hold.
+ */
+class RttHistoryBuffer
+{
+public:
+  RttHistoryBuffer ();
+
+  /**
+   * \brief Check if the buffer is empty
+   * \return true if there are no entries
+   */
+  bool Empty (void) const;
+
+  /**
+   * \brief Get the number of entries
+   * \return the number of entries
+   */
+  uint32_t Size (void) const;
+
+  /**
+   * \brief Get the oldest entry
+   * \return a reference to the oldest entry
+   */
+  RttHistory& Front (void);
+
+  /**
+   * \brief Get an entry by age
+   * \param i index of the entry, 0 being the oldest
+   * \return a reference to the entry
+   */
+  RttHistory& At (uint32_t i);
+
+  /**
+   * \brief Append an entry after the newest one
+   * \param h the entry
+   */
+  void PushBack (const RttHistory &h);
+
+  /**
+   * \brief Remove the oldest entry
+   */
+  void PopFront (void);
+
+  /**
+   * \brief Remove the n oldest entries
+   * \param n number of entries to remove
+   */
+  void PopFront (uint32_t n);
+
+  /**
+   * \brief Remove all the entries
+   */
+  void Clear (void);
+
+  /**
+   * \brief Find the entry covering a sequence number
+   * \param seq the sequence number
+   * \return the entry with seq <= s < seq + count, or nullptr
+   */
+  RttHistory* Find (const SequenceNumber32 &seq);
+
+  /**
+   * \brief Find the index of the entry covering a sequence number
+   * \param seq the sequence number
+   * \return the index of the entry with seq <= s < seq + count, or Size ()
+   */
+  uint32_t Index (const SequenceNumber32 &seq);
+
+private:
+  /**
+   * \brief Double the capacity, keeping the entries in order
+   */
+  void Grow (void);
+
+  std::vector<RttHistory> m_entries; //!< Storage, size is a power of two
+  uint32_t                m_head;    //!< Index of the oldest entry
+  uint32_t                m_size;    //!< Number of entries
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Helper class to store the per-connection PeakHopper RTO state
+ *
+ * Every TcpSocketBase owns one instance, so flows sharing a process do not
+ * share their PeakHopper history. A forked socket starts from a copy of the
+ * listening socket's state.
+ */
+class PeakHopperState
+{
+public:
+  PeakHopperState ();
+  /**
+   * \brief Copy constructor
+   * \param s the object to copy
+   */
+  PeakHopperState (const PeakHopperState& s);
+public:
+  Time            lastRtt;         //!< RTT estimate after the last sample (RTT_l)
+  double          w;               //!< Sum of RTO/RTT observed at retransmissions
+  double          ratio;           //!< Sum of RTO/RTT observed at RTO updates
+  uint32_t        cntRtoUpdate;    //!< Number of RTO updates
+  uint32_t        totalRetransmit; //!< Number of retransmitted segments
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Histogram with logarithmic buckets, four per octave
+ *
+ * Bucket 0 counts the values below the base, bucket i > 0 the values in
+ * [base * 2^((i-1)/4), base * 2^(i/4)), and the last bucket everything
+ * above. The buckets are allocated with the histogram, so that adding a
+ * value never allocates.
+ */
+class RtoHistogram
+{
+public:
+  static constexpr uint32_t N_BUCKETS = 64; //!< Number of buckets, overflow included
+  static constexpr uint32_t PER_OCTAVE = 4; //!< Buckets per doubling of the value
+
+  /**
+   * \brief Constructor
+   * \param base upper bound of bucket 0
+   */
+  RtoHistogram (double base);
+
+  /**
+   * \brief Count a value
+   * \param v the value
+   */
+  void Add (double v);
+
+  /**
+   * \brief Get the count of a bucket
+   * \param i the bucket
+   * \return the number of values in bucket i
+   */
+  uint32_t GetCount (uint32_t i) const;
+
+  /**
+   * \brief Get the lower bound of a bucket
+   * \param i the bucket
+   * \return 0 for bucket 0, the lower bound otherwise
+   */
+  double GetLower (uint32_t i) const;
+
+  /**
+   * \brief Get the upper bound of a bucket
+   * \param i the bucket
+   * \return the upper bound, infinity for the last bucket
+   */
+  double GetUpper (uint32_t i) const;
+
+private:
+  double   m_base;               //!< Upper bound of bucket 0
+  uint32_t m_count[N_BUCKETS];   //!< Count of every bucket
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief RTO quality accounting of one connection
+ *
+ * Counts the RTO/RTT ratio at every RTO update, the timeouts, and for each
+ * loss episode (the timeouts until the next cumulative ACK) the time the
+ * sender stalled and the deepest backoff. With spurious RTO detection
+ * enabled, an episode is classified as spurious once undone and as genuine
+ * once confirmed; the others stay unclassified. Every event is one O(1)
+ * update of preallocated counters; TcpSocketBase reports the result once,
+ * when the connection ends, through its RtoStats trace source.
+ */
+class RtoStats
+{
+public:
+  static constexpr uint32_t MAX_BACKOFF = 15; //!< Deeper backoffs are counted as MAX_BACKOFF
+
+  RtoStats ();
+
+  /**
+   * \brief Count an RTO update
+   * \param ratio RTO / smoothed RTT
+   */
+  void RtoUpdate (double ratio);
+
+  /**
+   * \brief Count a retransmission timeout
+   * \param now the time of the timeout
+   */
+  void Timeout (const Time &now);
+
+  /**
+   * \brief Count a cumulative ACK, which ends the current episode
+   * \param now the time of the ACK
+   */
+  void Progress (const Time &now);
+
+  /**
+   * \brief The current episode was not spurious
+   */
+  void Genuine (void);
+
+  /**
+   * \brief The current episode was spurious
+   */
+  void Spurious (void);
+
+  /**
+   * \brief Count the episode still running when the connection ends
+   */
+  void Finish (void);
+
+  /**
+   * \brief Write the statistics as CSV rows flow,metric,lower,upper,count
+   *
+   * Only the non-empty buckets are written. Counters have no bounds.
+   *
+   * \param os the output stream
+   * \param flow the flow identifier of the rows
+   */
+  void Write (std::ostream &os, uint32_t flow) const;
+
+public:
+  RtoHistogram rtoByRtt;                 //!< RTO / RTT at every RTO update
+  RtoHistogram stall;                    //!< Seconds from the last ACK to the last timeout of an episode
+  uint32_t     backoff[MAX_BACKOFF + 1]; //!< Episodes by number of timeouts
+  uint32_t     timeouts;                 //!< Retransmission timeouts
+  uint32_t     episodes;                 //!< Loss episodes
+  uint32_t     spurious;                 //!< Episodes undone as spurious
+  uint32_t     genuine;                  //!< Episodes confirmed as genuine
+
+private:
+  uint32_t     m_backoff;                //!< Timeouts of the current episode
+  uint8_t      m_verdict;                //!< 0 unclassified, 1 genuine, 2 spurious
+  Time         m_lastProgress;           //!< Time of the last cumulative ACK
+  Time         m_lastTimeout;            //!< Time of the last timeout
+};
+
 /**
  * \ingroup socket
  * \ingroup tcp
@@ -460,6 +712,41 @@ public:
    */
   void SetRecoveryAlgorithm (Ptr<TcpRecoveryOps> recovery);
 
+  /**
+   * \brief Install a retransmission timeout algorithm on this socket
+   *
+   * \param rtoOps Algorithm to be installed
+   */
+  void SetRtoAlgorithm (Ptr<TcpRtoOps> rtoOps);
+
+  /**
+   * \brief Create and install a retransmission timeout algorithm
+   *
+   * \param rtoType TypeId of a TcpRtoOps subclass
+   */
+  void SetRtoType (TypeId rtoType);
+
+  /**
+   * \brief Get the TypeId of the installed retransmission timeout algorithm
+   * \return the TypeId of the RTO algorithm
+   */
+  TypeId GetRtoType (void) const;
+
+  /**
+   * \brief Enable or disable PeakHopper
+   *
+   * Enabling it installs TcpRtoPeakHopper as the RTO algorithm.
+   *
+   * \param peakHopper true to enable PeakHopper
+   */
+  void SetPeakHopper (bool peakHopper);
+
+  /**
+   * \brief Check if PeakHopper is enabled
+   * \return true if PeakHopper is enabled
+   */
+  bool GetPeakHopper (void) const;
+
   /**
    * \brief Mark ECT(0) codepoint
    *
@@ -612,6 +899,13 @@ public:
   typedef void (* TcpTxRxTracedCallback)(const Ptr<const Packet> packet, const TcpHeader& header,
                                          const Ptr<const TcpSocketBase> socket);
 
+  /**
+   * TracedCallback signature for the RTO statistics of a finished connection
+   *
+   * \param [in] stats the RTO statistics
+   */
+  typedef void (* RtoStatsTracedCallback)(const RtoStats &stats);
+
 protected:
   // Implementing ns3::TcpSocket -- Attribute get/set
   // inherited, no need to doc
@@ -1072,6 +1366,167 @@ protected:
    */
   virtual void ReTxTimeout (void);
 
+  /**
+   * \brief Stage of the spurious RTO detection of the current loss episode
+   */
+  typedef enum
+  {
+    RTO_UNDO_NONE,     //!< No detection running
+    RTO_UNDO_EIFEL,    //!< Waiting for a new ACK to compare its timestamp echo (RFC 3522)
+    RTO_UNDO_FRTO,     //!< F-RTO, waiting for the first ACK after the timeout (RFC 5682)
+    RTO_UNDO_FRTO_NEW, //!< F-RTO, two new segments sent, waiting for the next ACK
+    RTO_UNDO_LOSS,     //!< Genuine RTO, mark the sent list lost once the head is ACKed
+    RTO_UNDO_DSACK     //!< Counting the D-SACKed retransmissions (RFC 3708)
+  } RtoUndoState_t;
+
+  /**
+   * \brief Check whether the RTO of the current loss episode was spurious
+   *
+   * Called with SpuriousRtoDetection for every ACK that does not go below
+   * SND.UNA, once the acknowledged data is discarded. Undoes the window
+   * reduction of a spurious RTO, or marks the sent list lost otherwise.
+   *
+   * \param tcpHeader the ACK
+   * \param ackNumber its acknowledgment number
+   * \param oldHeadSequence SND.UNA before the ACK
+   * \return true if F-RTO has to send two new segments
+   */
+  bool DetectSpuriousRto (const TcpHeader &tcpHeader, const SequenceNumber32 &ackNumber,
+                          const SequenceNumber32 &oldHeadSequence);
+
+  /**
+   * \brief Restore the cwnd, ssthresh and RTO of before a spurious RTO
+   */
+  void UndoRto (void);
+
+  /**
+   * \brief The RTO was genuine, mark the sent list lost as a normal RTO does
+   */
+  void ConfirmRto (void);
+
+  /**
+   * \brief Send up to two new segments for F-RTO, regardless of cwnd
+   * \return the number of segments sent
+   */
+  uint32_t SendFrtoNewData (void);
+
+  /**
+   * \brief Read the D-SACK block of an ACK (RFC 2883)
+   *
+   * Only a first SACK block below the cumulative ACK is recognized.
+   *
+   * \param tcpHeader the ACK
+   * \param ackNumber its acknowledgment number
+   * \param start set to the start of the duplicate segment
+   * \param end set to its end
+   * \return true if the ACK reports a duplicate segment
+   */
+  bool ReadDsack (const TcpHeader &tcpHeader, const SequenceNumber32 &ackNumber,
+                  SequenceNumber32 *start, SequenceNumber32 *end) const;
+
+  /**
+   * \brief Record the send time of a data segment for RACK
+   *
+   * \param seq first sequence number of the segment
+   * \param sz its size
+   * \param isRetransmission true if it was sent before
+   */
+  void RackSent (const SequenceNumber32 &seq, uint32_t sz, bool isRetransmission);
+
+  /**
+   * \brief Update RACK with the segments delivered by an ACK (RFC 8985, Section 6.2)
+   *
+   * The cumulatively acknowledged segments leave the send time record. Of
+   * each SACK block only the last segment is looked at: it is the most
+   * recently sent one, unless a segment inside the block was retransmitted.
+   *
+   * \param tcpHeader the ACK
+   * \param ackNumber its acknowledgment number
+   */
+  void RackOnAck (const TcpHeader &tcpHeader, const SequenceNumber32 &ackNumber);
+
+  /**
+   * \brief Take a delivered segment as the RACK segment if it was sent last
+   * \param h the send time record of the segment
+   */
+  void RackUpdate (const RttHistory &h);
+
+  /**
+   * \brief Enter the recovery if RACK deems the head lost
+   *
+   * The head is lost once a segment sent after it has been delivered and
+   * it has been outstanding for RACK.rtt plus the reordering window. If
+   * that time is still to come, the reordering timer is armed for it.
+   *
+   * \param currentDelivered Currently (S)ACKed bytes
+   * \return true if the recovery started
+   */
+  bool RackDetectLoss (uint32_t currentDelivered);
+
+  /**
+   * \brief The RACK reordering timer expired
+   */
+  void RackTimeout (void);
+
+  /**
+   * \brief Arm the tail loss probe timer (RFC 8985, Section 7.2)
+   */
+  void ScheduleTlp (void);
+
+  /**
+   * \brief The tail loss probe timer expired, send a probe
+   */
+  void TlpTimeout (void);
+
+  /**
+   * \brief Check whether the outstanding probe repaired a loss (RFC 8985, Section 7.4)
+   *
+   * \param tcpHeader the ACK
+   * \param ackNumber its acknowledgment number
+   * \param oldHeadSequence SND.UNA before the ACK
+   * \param scoreboardUpdated true if the ACK SACKed new data
+   * \param currentDelivered Currently (S)ACKed bytes
+   */
+  void ProcessTlpAck (const TcpHeader &tcpHeader, const SequenceNumber32 &ackNumber,
+                      const SequenceNumber32 &oldHeadSequence, bool scoreboardUpdated,
+                      uint32_t currentDelivered);
+
+  /**
+   * \brief Seed the RTT estimation from the TcpMetricsCache of the node
+   *
+   * Called once the peer address is known, when connecting or forking.
+   * Does nothing if no cache is aggregated to the node.
+   */
+  void LoadMetrics (void);
+
+  /**
+   * \brief Write the RTT estimation of the connection to the TcpMetricsCache
+   * \param closing true to merge it as a closed connection, false to
+   *        overwrite the entry with the current state (ShareLive)
+   */
+  void StoreMetrics (bool closing);
+
+  /**
+   * \brief Fire the RtoStats trace, once per connection
+   */
+  void ReportRtoStats (void);
+
+  /**
+   * \brief Restart the retransmission timer for m_rto, with LazyRetxTimer
+   *
+   * Only the deadline moves if the pending event fires before it, the event
+   * then re-arms itself for the remaining time.
+   */
+  void RestartRetxTimer (void);
+
+  /**
+   * \brief The retransmission event fired, with LazyRetxTimer
+   *
+   * Calls ReTxTimeout () if the deadline is reached, otherwise re-arms the
+   * event for the remaining time.
+   */
+  void RetxTimerExpired (void);
+
   /**
    * \brief Action upon delay ACK timeout, i.e. send an ACK
    */
@@ -1250,6 +1705,7 @@ protected:
   SequenceNumber32 GetHighRxAck (void) const;
 
     bool                   m_peakHopper {false};
+    PeakHopperState        m_phState;   //!< Per-connection PeakHopper state
     TracedValue<double>    m_mean_retransmission{0.0};
     TracedValue<double>    m_rto_by_rtt{0.0};
 
@@ -1257,6 +1713,10 @@ protected:
 protected:
   // Counters and events
   EventId           m_retxEvent     {}; //!< Retransmission event
+  bool              m_lazyRetxTimer {false}; //!< Move the deadline instead of rescheduling m_retxEvent
+  Time              m_retxDeadline  {0}; //!< Retransmission timeout, with m_lazyRetxTimer
+  Time              m_retxFireTime  {0}; //!< Time m_retxEvent runs RetxTimerExpired, with m_lazyRetxTimer
+  TracedCallback<Time> m_rtoExpiredTrace; //!< Trace of the retransmission timeouts, with the RTO that expired
   EventId           m_lastAckEvent  {}; //!< Last ACK timeout event
   EventId           m_delAckEvent   {}; //!< Delayed ACK timeout event
   EventId           m_persistEvent  {}; //!< Persist event: Send 1 byte to probe for a non-zero Rx window
@@ -1286,7 +1746,8 @@ protected:
   Time              m_cnTimeout        {Seconds (0.0)};   //!< Timeout for connection retry
 
   // History of RTT
-  std::deque<RttHistory>      m_history;         //!< List of sent packet
+  RttHistoryBuffer            m_history;         //!< List of sent packet
+  std::vector<Time>           m_rttSamples;      //!< RTT samples of the ACK being processed
 
   // Connections to other layers of TCP/IP
   Ipv4EndPoint*       m_endPoint  {nullptr}; //!< the IPv4 endpoint
@@ -1338,10 +1799,46 @@ protected:
   uint32_t               m_retxThresh {3};   //!< Fast Retransmit threshold
   bool                   m_limitedTx  {true}; //!< perform limited transmit
 
+  // Spurious RTO detection
+  bool             m_spuriousRtoDetection {false};        //!< Detect and undo spurious RTOs
+  RtoUndoState_t   m_rtoUndoState         {RTO_UNDO_NONE}; //!< Detection stage of the last RTO
+  uint32_t         m_undoCwnd             {0};  //!< cWnd before the RTO
+  uint32_t         m_undoSsThresh         {0};  //!< ssThresh before the RTO
+  Time             m_undoRto              {0};  //!< RTO before it was backed off
+  uint32_t         m_undoTsVal            {0};  //!< Timestamp of the retransmission of the head
+  SequenceNumber32 m_undoRecover          {0};  //!< HighData at the RTO
+  uint32_t         m_undoRetrans          {0};  //!< Bytes retransmitted since the RTO and not D-SACKed
+  bool             m_dsackPending         {false}; //!< Report a duplicate segment in the next ACK
+  SequenceNumber32 m_dsackStart           {0};  //!< Start of the duplicate segment
+  SequenceNumber32 m_dsackEnd             {0};  //!< End of the duplicate segment
+
+  // RACK-TLP loss detection
+  bool             m_rackTlp        {false}; //!< Detect losses with RACK and probe tail losses
+  RttHistoryBuffer m_rackSent;               //!< Last send time of every outstanding segment
+  Time             m_rackXmitTime   {0};     //!< RACK.xmit_ts, send time of the last sent delivered segment
+  SequenceNumber32 m_rackEndSeq     {0};     //!< RACK.end_seq, end of that segment
+  Time             m_rackRtt        {0};     //!< RACK.rtt, RTT measured on that segment
+  EventId          m_rackReoEvent   {};      //!< RACK reordering timer
+  EventId          m_tlpEvent       {};      //!< Tail loss probe timer
+  bool             m_tlpOutstanding {false}; //!< A probe was sent and is not resolved yet
+  bool             m_tlpRetrans     {false}; //!< The outstanding probe was a retransmission
+  SequenceNumber32 m_tlpHighSeq     {0};     //!< TLP.end_seq, SND.NXT once the probe was sent
+
+  // Destination metrics cache
+  Ptr<TcpMetrics>  m_metrics        {};      //!< Entry of the peer, with a TcpMetricsCache on the node
+  bool             m_metricsShared  {false}; //!< Write every RTT sample to m_metrics
+  bool             m_metricsSeeded  {false}; //!< The RTT estimation started from m_metrics
+
+  // RTO quality accounting
+  RtoStats         m_rtoStats;                 //!< RTO statistics of the connection
+  bool             m_rtoStatsReported {false}; //!< m_rtoStats was traced
+  TracedCallback<const RtoStats &> m_rtoStatsTrace; //!< Trace of the RTO statistics at the end of the connection
+
   // Transmission Control Block
   Ptr<TcpSocketState>    m_tcb;               //!< Congestion control information
   Ptr<TcpCongestionOps>  m_congestionControl; //!< Congestion control
   Ptr<TcpRecoveryOps>    m_recoveryOps;       //!< Recovery Algorithm
+  Ptr<TcpRtoOps>         m_rtoOps;            //!< Retransmission timeout algorithm
   Ptr<TcpRateOps>        m_rateOps;           //!< Rate operations
 
   // Guesses over the other connection end
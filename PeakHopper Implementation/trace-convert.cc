@@ -0,0 +1,43 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+// Converts a binary trace written by simulate.cc (--trace_text=false) into
+// the cwnd/ssth/rtt/rto/rto_by_rtt/mean_retransmission .data files:
+//
+//   ./waf --run "scratch/trace-convert --input=trace.bin --prefix_name="
+
+#include "ns3/core-module.h"
+
+#include "binary-trace.h"
+
+using namespace ns3;
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "trace.bin";
+  std::string prefix_file_name = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Binary trace written by simulate", input);
+  cmd.AddValue ("prefix_name", "Prefix of the .data files", prefix_file_name);
+  cmd.Parse (argc, argv);
+
+  ConvertBinaryTrace (input, prefix_file_name);
+
+  return 0;
+}